@@ -1,6 +1,9 @@
 // automata.c - Cellular automata in C.
 // Copyright 2024 Jhonny Lanzuisi.
 // See LICENSE at end of file.
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,189 +12,2744 @@
 #include "gifenc.c"
 #include "raylib.h"
 
-#define BOARD_SIZE 100 // 2d matrix size is the square of this
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define X86_SIMD
+#endif
+
+#define CACHE_LINE 64
 #define RULES 50
 #define STATES 4
-#define COLOR_DEPTH 2
-#define COLORS 4 // should always be COLOR_DEPTH^2
+#define COMBOS 729 // neighbor count combinations, 9^(STATES - 1)
 #define WIDTH 1280
 #define HEIGHT 720
+#define GIF_SIZE 800 // longest side of exported gifs, when the board fits
+#define GIF_MAX 0xFFFF
+#define MAX_THREADS 256
+#define TILE_SIZE 64 // side of the squares whose activity is tracked
+#define TILE_LEVEL 6 // log2(TILE_SIZE)
+#define HASHLIFE_BUDGET ((size_t)256 << 20) // bytes of cached HashLife nodes
+#define HASHLIFE_MAX_JUMP ((uint64_t)1 << 48) // generations per HashLife jump
+#define HASHLIFE_MAX_LEVEL 60 // keeps quad sizes and positions in an int64_t
+#define JUMP 1000000 // generations skipped by the J key
+#define MAX_STEPPED 4096 // longest jump made without HashLife
+#define ZOOM_STEP 1.25f // zoom per notch of the mouse wheel
+#define MIN_ZOOM (1.0f / 65536) // pixels per cell
+#define MAX_ZOOM 256.0f
+#define PAN_SPEED 10.0f // pixels per frame the arrow keys pan
+#define MIN_OUTLINED 4.0f // pixels a cell needs for its outline to show
+
+// Heap storage for the cells of a grid. Every row starts on a cache line
+// and is padded to a whole number of them.
+//
+// The board is surrounded by a ring of halo cells, rows -1 and `rows` and
+// columns -1 and `cols`, that refresh_halo fills for the boundary so the
+// kernels can read past the edges. Column -1 is the last byte or word of
+// the padding before the row.
+typedef struct {
+    size_t stride; // bytes from the start of one row to the next
+    uint8_t *cells; // row 0
+    uint8_t *memory; // start of the allocation, before row -1
+} Board;
+
+// A TILE_SIZE square of an unbounded plane, both generations of it.
+typedef struct Chunk {
+    int64_t cx; // position in chunks, cell (0, 0) is in chunk (0, 0)
+    int64_t cy;
+    uint8_t cells[2][TILE_SIZE][TILE_SIZE];
+    int population;
+    uint8_t edges; // bit d is set if cells face the neighbor in direction d
+    bool changed;
+    struct Chunk *next; // hash chain
+} Chunk;
+
+// The live part of an unbounded plane, as a hash map of the chunks that
+// have or had live cells nearby. Everything else is dead.
+typedef struct {
+    Chunk **buckets;
+    size_t bucket_amount;
+    Chunk **chunks; // every chunk, in no particular order
+    size_t chunk_amount;
+    size_t chunk_capacity;
+    int front;
+} Plane;
+
+typedef enum {
+    Torus,
+    Dead, // everything past the edges is dead
+    Unbounded,
+} Boundary;
+
+// Tile flags: the tile differs from the previous generation, from the one
+// before that, was written to since it was last stepped, changed since the
+// window last drew it, and since update_pyramid last summed it. Unlike the
+// others, the last two last across generations until they're cleared by
+// whoever they're for.
+#define TILE_CHANGED 1
+#define TILE_CHANGED2 2
+#define TILE_EDITED 4
+#define TILE_UNSEEN 8
+#define TILE_UNSUMMED 16
+#define TILE_LASTING (TILE_UNSEEN | TILE_UNSUMMED)
+#define TILE_DIRTY (TILE_CHANGED | TILE_CHANGED2 | TILE_EDITED | TILE_LASTING)
+
+// The current generation is boards[front]; next_gen writes the other board
+// and then swaps their roles, so stepping never copies cells around.
+//
+// The board is split in TILE_SIZE squares and only tiles next to one that
+// changed are stepped, the others already hold their next generation in the
+// back board. With period2 set this includes tiles that came back to the
+// state of two generations ago.
+//
+// An Unbounded grid is the window on the top left of a plane, each tile
+// over the chunk at the same position.
+typedef struct {
+    int rows;
+    int cols;
+    bool packed; // two-state boards keep one bit per cell, 64 per word
+    Board boards[2];
+    int front;
+    int tile_rows;
+    int tile_cols;
+    uint8_t *tiles; // flags of each tile for the current generation
+    uint8_t *next_tiles;
+    int *active; // tiles stepped by the last next_gen
+    int active_amount;
+    bool period2;
+    bool modified;
+    Boundary boundary;
+    Plane plane;
+} Grid;
+
+typedef struct {
+    char *code;
+    int next_state;
+} Rule;
+
+typedef struct {
+    int rule_amount;
+    int default_state;
+    Rule rules[RULES];
+} RuleSet;
+
+typedef struct {
+    int state_amount;
+    RuleSet ruleset[STATES];
+    uint32_t colors[STATES]; // 0xRRGGBB of each state in exported gifs
+    // Filled by compile_rules: a neighbor in state s adds weight[s] to the
+    // neighborhood index, and table[state][index] is the next state.
+    int weight[STATES];
+    uint8_t table[STATES][COMBOS];
+} CA;
+
+typedef struct {
+    Color bg;
+    Color fg;
+} Colors;
+
+#define PYRAMID_LEVELS 32
+
+// Density of live cells over the 2^k squares of a board, for every level k
+// from 1 to the one of a single square, 255 for squares full of live cells.
+// The levels up to TILE_LEVEL are within tiles, the ones above over groups
+// of them. Squares past the edges of the board average the part on it.
+typedef struct {
+    uint8_t *levels[PYRAMID_LEVELS]; // from levels[1], a row after the other
+    int level_amount;                // levels[level_amount - 1] is 1x1
+    int rows;                        // of the board
+    int cols;
+    int *summed; // tiles summed by the last update_pyramid
+    int summed_amount;
+} Pyramid;
+
+// Tiles left to right - 1 of the rows from top down, uploaded together.
+typedef struct {
+    int left;
+    int right;
+    int top;
+} TileSpan;
+
+// The board as a texture of a pixel per cell, of the part of it that fits
+// in the window, drawn scaled up with point filtering. Each frame uploads
+// the tiles flagged TILE_UNSEEN, through pixels, which has room for the
+// whole texture.
+typedef struct {
+    Texture2D texture;
+    Color *pixels;
+    int rows; // of the texture, 0 until it's loaded
+    int cols;
+    TileSpan *spans; // two rows of tiles' worth, for upload_tiles
+    size_t uploaded; // bytes sent by the last frame
+    int level;       // of the pyramid shown, 0 for the cells themselves
+    int top;         // square of the level at the top left of the texture
+    int left;
+    Pyramid pyramid;
+    Camera2D camera; // a world unit is a cell
+    bool moved;      // by the user, since the camera was fitted to the board
+    RenderTexture2D lines; // outlines of the cells, drawn over them
+    Camera2D lines_camera; // that the outlines were drawn for
+    int lines_rows;
+    int lines_cols;
+    bool rects;      // draw a rectangle per cell instead
+} BoardView;
+
+typedef void (*Task)(void *ctx, int item);
+
+// Persistent workers that run the items of a job split in bands, such as
+// the active tiles of a grid. parallel_for hands out one job and waits for
+// every band, the caller's thread taking the first one.
+typedef struct {
+    pthread_t threads[MAX_THREADS];
+    int thread_amount; // workers plus the calling thread
+    pthread_mutex_t run;  // held by the parallel_for using the pool
+    pthread_mutex_t lock; // guards everything below
+    pthread_cond_t work;
+    pthread_cond_t done;
+    unsigned long job;
+    int bands;
+    int pending;
+    bool quit;
+    Task task;
+    void *ctx;
+    int items;
+} Pool;
+
+// Quadtree node of the HashLife engine, a 2^level square of cells. Nodes
+// are hash-consed, so equal squares are the same node, and remember the
+// center half of their square 2^result_step generations later.
+typedef struct Quad {
+    struct Quad *nw, *ne, *sw, *se; // NULL for single cells, level 0
+    struct Quad *result;
+    struct Quad *next; // hash chain
+    uint64_t population;
+    int level;
+    int result_step;
+    bool marked;
+} Quad;
+
+typedef struct {
+    Quad **buckets;
+    size_t bucket_amount;
+    size_t node_amount;
+    size_t budget; // bytes of nodes kept before collecting garbage
+    Quad cells[2]; // the dead and the live level 0 node
+    Quad *empty[64];
+    Quad *root;
+    int64_t top;  // plane coordinates of the root's top left cell
+    int64_t left;
+    uint16_t birth;
+    uint16_t survive;
+    pthread_mutex_t lock;
+} HashLife;
+
+typedef enum {
+    TitleScreen,
+    Play,
+    Paused,
+} GameStates;
+
+static inline uint8_t *board_row(const Board *b, const int row) {
+    return b->cells + (ptrdiff_t)row * (ptrdiff_t)b->stride;
+}
+
+static inline uint64_t *board_bits(const Board *b, const int row) {
+    return (uint64_t *)board_row(b, row);
+}
+
+static inline const Board *front_board(const Grid *g) {
+    return &g->boards[g->front];
+}
+
+static inline Board *back_board(Grid *g) { return &g->boards[!g->front]; }
+
+static inline uint8_t *grid_row(const Grid *g, const int row) {
+    return board_row(front_board(g), row);
+}
+
+static inline uint64_t *grid_bits(const Grid *g, const int row) {
+    return board_bits(front_board(g), row);
+}
+
+bool alloc_board(Board *b, const int rows, const int cols,
+                 const bool packed) {
+    // Room for column `cols` and the column -1 of the next row.
+    size_t row_bytes = packed ? ((cols + 64) / 64 + 1) * sizeof(uint64_t)
+                              : (size_t)cols + 2;
+    size_t bytes = 0;
+
+    b->stride = (row_bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    bytes = CACHE_LINE + (rows + 2) * b->stride;
+#ifdef _WIN32
+    b->memory = _aligned_malloc(bytes, CACHE_LINE);
+#else
+    b->memory = aligned_alloc(CACHE_LINE, bytes);
+#endif
+    if (b->memory == NULL) {
+        b->cells = NULL;
+        return false;
+    }
+
+    memset(b->memory, 0, bytes);
+    b->cells = b->memory + CACHE_LINE + b->stride;
+    return true;
+}
+
+void free_board(Board *b) {
+#ifdef _WIN32
+    _aligned_free(b->memory);
+#else
+    free(b->memory);
+#endif
+    b->cells = b->memory = NULL;
+}
+
+// Neighbor directions of a chunk, d and 7 - d are opposite.
+static const int chunk_dy[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+static const int chunk_dx[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+
+// The chunk coordinate of a plane coordinate, rounding down.
+static inline int64_t chunk_of(const int64_t v) {
+    return v >= 0 ? v / TILE_SIZE : (v + 1) / TILE_SIZE - 1;
+}
+
+static size_t chunk_hash(const int64_t cx, const int64_t cy) {
+    uint64_t h = (uint64_t)cx;
+
+    h = h * 0x9E3779B97F4A7C15 + (uint64_t)cy;
+    h = h * 0x9E3779B97F4A7C15;
+    return h ^ (h >> 29);
+}
+
+Chunk *find_chunk(const Plane *p, const int64_t cx, const int64_t cy) {
+    Chunk *c = NULL;
+
+    if (p->bucket_amount == 0) {
+        return NULL;
+    }
+
+    for (c = p->buckets[chunk_hash(cx, cy) & (p->bucket_amount - 1)];
+         c != NULL; c = c->next) {
+        if (c->cx == cx && c->cy == cy) {
+            return c;
+        }
+    }
+    return NULL;
+}
+
+static bool resize_chunk_buckets(Plane *p, const size_t amount) {
+    Chunk **buckets = calloc(amount, sizeof(Chunk *));
+    Chunk *c = NULL;
+    size_t h = 0;
+
+    if (buckets == NULL) {
+        return false;
+    }
+
+    for (size_t i = 0; i < p->chunk_amount; i++) {
+        c = p->chunks[i];
+        h = chunk_hash(c->cx, c->cy) & (amount - 1);
+        c->next = buckets[h];
+        buckets[h] = c;
+    }
+
+    free(p->buckets);
+    p->buckets = buckets;
+    p->bucket_amount = amount;
+    return true;
+}
+
+// The chunk at (cx, cy), added dead if there was none. NULL when out of
+// memory.
+Chunk *add_chunk(Plane *p, const int64_t cx, const int64_t cy) {
+    Chunk *c = find_chunk(p, cx, cy);
+    Chunk **chunks = NULL;
+    size_t capacity = 0;
+    size_t h = 0;
+
+    if (c != NULL) {
+        return c;
+    }
+
+    if (p->chunk_amount == p->chunk_capacity) {
+        capacity = p->chunk_capacity > 0 ? p->chunk_capacity * 2 : 64;
+        chunks = realloc(p->chunks, capacity * sizeof(Chunk *));
+        if (chunks == NULL) {
+            return NULL;
+        }
+        p->chunks = chunks;
+        p->chunk_capacity = capacity;
+    }
+    if (p->chunk_amount >= p->bucket_amount &&
+        !resize_chunk_buckets(p, p->bucket_amount > 0 ? p->bucket_amount * 2
+                                                      : 64)) {
+        return NULL;
+    }
+
+    c = calloc(1, sizeof(Chunk));
+    if (c == NULL) {
+        return NULL;
+    }
+
+    c->cx = cx;
+    c->cy = cy;
+    h = chunk_hash(cx, cy) & (p->bucket_amount - 1);
+    c->next = p->buckets[h];
+    p->buckets[h] = c;
+    p->chunks[p->chunk_amount++] = c;
+    return c;
+}
+
+// Takes c out of the hash map, the caller removes it from the chunk list.
+static void unlink_chunk(Plane *p, const Chunk *c) {
+    Chunk **link =
+        &p->buckets[chunk_hash(c->cx, c->cy) & (p->bucket_amount - 1)];
+
+    while (*link != c) {
+        link = &(*link)->next;
+    }
+    *link = c->next;
+}
+
+// Kills every cell of the plane.
+void clear_plane(Plane *p) {
+    for (size_t i = 0; i < p->chunk_amount; i++) {
+        free(p->chunks[i]);
+    }
+    if (p->buckets != NULL) {
+        memset(p->buckets, 0, p->bucket_amount * sizeof(Chunk *));
+    }
+    p->chunk_amount = 0;
+}
+
+void free_plane(Plane *p) {
+    clear_plane(p);
+    free(p->buckets);
+    free(p->chunks);
+    *p = (Plane){0};
+}
+
+bool copy_plane(Plane *dst, const Plane *src) {
+    Chunk *c = NULL;
+
+    clear_plane(dst);
+    for (size_t i = 0; i < src->chunk_amount; i++) {
+        c = add_chunk(dst, src->chunks[i]->cx, src->chunks[i]->cy);
+        if (c == NULL) {
+            return false;
+        }
+        memcpy(c->cells, src->chunks[i]->cells, sizeof(c->cells));
+        c->population = src->chunks[i]->population;
+        c->edges = src->chunks[i]->edges;
+        c->changed = src->chunks[i]->changed;
+    }
+
+    dst->front = src->front;
+    return true;
+}
+
+// Sets a cell of the current generation anywhere on the plane. The chunk
+// statistics are left for scan_chunk.
+bool set_plane_cell(Plane *p, const int64_t row, const int64_t col,
+                    const int state) {
+    const int64_t cy = chunk_of(row);
+    const int64_t cx = chunk_of(col);
+    Chunk *c = state ? add_chunk(p, cx, cy) : find_chunk(p, cx, cy);
+
+    if (c == NULL) {
+        return state == 0;
+    }
+
+    c->cells[p->front][row - cy * TILE_SIZE][col - cx * TILE_SIZE] = state;
+    return true;
+}
+
+static void free_boards(Grid *g) {
+    free_board(&g->boards[0]);
+    free_board(&g->boards[1]);
+    free(g->tiles);
+    free(g->next_tiles);
+    free(g->active);
+    g->tiles = g->next_tiles = NULL;
+    g->active = NULL;
+    g->active_amount = 0;
+    g->front = 0;
+}
+
+void free_grid(Grid *g) {
+    free_boards(g);
+    free_plane(&g->plane);
+}
+
+// Makes every tile step on the next generation, after the board was written
+// to without set_cell.
+void touch_grid(Grid *g) {
+    memset(g->tiles, TILE_DIRTY, g->tile_rows * g->tile_cols);
+}
+
+// Makes room for a board of the requested size. The current board is kept,
+// contents included, when the layout does not change. The back board is
+// only allocated once the grid is stepped.
+bool reshape_grid(Grid *g, const int rows, const int cols, const bool packed) {
+    size_t tiles = 0;
+
+    if (front_board(g)->cells != NULL && g->rows == rows && g->cols == cols &&
+        g->packed == packed) {
+        return true;
+    }
+
+    free_boards(g);
+    g->rows = rows;
+    g->cols = cols;
+    g->packed = packed;
+    g->tile_rows = (rows + TILE_SIZE - 1) / TILE_SIZE;
+    g->tile_cols = (cols + TILE_SIZE - 1) / TILE_SIZE;
+
+    tiles = (size_t)g->tile_rows * g->tile_cols;
+    g->tiles = malloc(tiles);
+    g->next_tiles = malloc(tiles);
+    g->active = malloc(tiles * sizeof(int));
+    if (g->tiles == NULL || g->next_tiles == NULL || g->active == NULL ||
+        !alloc_board(&g->boards[g->front], rows, cols, packed)) {
+        free_boards(g);
+        return false;
+    }
+
+    touch_grid(g);
+    return true;
+}
+
+bool init_grid(Grid *g, const int rows, const int cols, const bool packed) {
+    if (!reshape_grid(g, rows, cols, packed)) {
+        return false;
+    }
+
+    memset(front_board(g)->cells, 0, rows * front_board(g)->stride);
+    touch_grid(g);
+    return true;
+}
+
+bool copy_grid(Grid *dst, const Grid *src) {
+    if (!reshape_grid(dst, src->rows, src->cols, src->packed)) {
+        return false;
+    }
+
+    memcpy(front_board(dst)->cells, front_board(src)->cells,
+           src->rows * front_board(src)->stride);
+    touch_grid(dst);
+    dst->period2 = src->period2;
+    dst->modified = src->modified;
+    dst->boundary = src->boundary;
+    return copy_plane(&dst->plane, &src->plane);
+}
+
+// Kills every cell, those of the plane outside the board included.
+void clear_board(Grid *g) {
+    memset(front_board(g)->cells, 0, g->rows * front_board(g)->stride);
+    touch_grid(g);
+    clear_plane(&g->plane);
+}
+
+int get_cell(const Grid *g, const int row, const int col) {
+    if (g->packed) {
+        return (grid_bits(g, row)[col / 64] >> (col % 64)) & 1;
+    }
+    return grid_row(g, row)[col];
+}
+
+// Writes a cell without marking its tile, for callers that keep the tile
+// flags themselves.
+static void put_cell(Grid *g, const int row, const int col, const int state) {
+    if (g->packed) {
+        uint64_t bit = (uint64_t)1 << (col % 64);
+
+        if (state) {
+            grid_bits(g, row)[col / 64] |= bit;
+        } else {
+            grid_bits(g, row)[col / 64] &= ~bit;
+        }
+    } else {
+        grid_row(g, row)[col] = state;
+    }
+}
+
+void set_cell(Grid *g, const int row, const int col, const int state) {
+    put_cell(g, row, col, state);
+    g->tiles[(row / TILE_SIZE) * g->tile_cols + col / TILE_SIZE] = TILE_DIRTY;
+}
+
+// Switch between the byte and the bit-packed layout, keeping the cells.
+bool pack_grid(Grid *g, const bool packed) {
+    Grid tmp = {0};
+
+    if (g->packed == packed) {
+        return true;
+    }
+
+    if (!init_grid(&tmp, g->rows, g->cols, packed)) {
+        return false;
+    }
+
+    for (int i = 0; i < g->rows; i++) {
+        for (int j = 0; j < g->cols; j++) {
+            set_cell(&tmp, i, j, get_cell(g, i, j));
+        }
+    }
+
+    tmp.period2 = g->period2;
+    tmp.modified = g->modified;
+    tmp.boundary = g->boundary;
+    tmp.plane = g->plane;
+    free_boards(g);
+    *g = tmp;
+    return true;
+}
+
+// Fills the halo around the board for its boundary: the cells of the
+// opposite edge on a torus, dead cells otherwise. Columns are done after
+// rows so that the corners come from the opposite corner.
+void refresh_halo(Grid *g) {
+    const Board *b = front_board(g);
+    const bool wrap = g->boundary == Torus;
+    const size_t bytes = g->packed ? (g->cols + 63) / 64 * sizeof(uint64_t)
+                                   : (size_t)g->cols;
+    const int last = g->cols - 1;
+    uint64_t *bits = NULL;
+    uint8_t *row = NULL;
+
+    if (wrap) {
+        memcpy(board_row(b, -1), board_row(b, g->rows - 1), bytes);
+        memcpy(board_row(b, g->rows), board_row(b, 0), bytes);
+    } else {
+        memset(board_row(b, -1), 0, bytes);
+        memset(board_row(b, g->rows), 0, bytes);
+    }
+
+    for (int i = -1; i <= g->rows; i++) {
+        if (g->packed) {
+            bits = board_bits(b, i);
+            bits[-1] = wrap ? ((bits[last / 64] >> (last % 64)) & 1) << 63 : 0;
+            bits[g->cols / 64] &= ~((uint64_t)1 << (g->cols % 64));
+            bits[g->cols / 64] |= (wrap ? bits[0] & 1 : 0) << (g->cols % 64);
+        } else {
+            row = board_row(b, i);
+            row[-1] = wrap ? row[last] : 0;
+            row[g->cols] = wrap ? row[0] : 0;
+        }
+    }
+}
+
+void print_grid_state(const Grid *g) {
+    for (int i = 0; i < g->rows; i++) {
+        for (int j = 0; j < g->cols; j++) {
+            if (get_cell(g, i, j) > 0) {
+                printf("%d ", get_cell(g, i, j));
+            } else {
+                printf("- ");
+            }
+        }
+        printf("\n");
+    }
+}
+
+// Bit n of birth/survive is set when a dead/live cell with n live neighbors
+// is alive in the next generation.
+void life_masks(const CA *ca, uint16_t *birth, uint16_t *survive) {
+    *birth = *survive = 0;
+
+    for (int n = 0; n <= 8; n++) {
+        if (ca->table[0][n]) {
+            *birth |= 1 << n;
+        }
+        if (ca->table[1][n]) {
+            *survive |= 1 << n;
+        }
+    }
+}
+
+// Cells with exactly n live neighbors, given the bit-sliced counts b0..b3.
+static inline uint64_t count_is(const uint64_t b[4], const int n) {
+    return (n & 1 ? b[0] : ~b[0]) & (n & 2 ? b[1] : ~b[1]) &
+           (n & 4 ? b[2] : ~b[2]) & (n & 8 ? b[3] : ~b[3]);
+}
+
+// Neighbor words shifted so that bit j holds column j - 1 (west) or j + 1
+// (east) of the same row. The halo supplies the columns past the edges.
+static inline uint64_t west_word(const uint64_t *r, const int w) {
+    return (r[w] << 1) | (r[w - 1] >> 63);
+}
+
+static inline uint64_t east_word(const uint64_t *r, const int w) {
+    return (r[w] >> 1) | (r[w + 1] << 63);
+}
+
+// Full adder over 64 lanes: a + b + c == sum + 2 * carry.
+static inline void add3(const uint64_t a, const uint64_t b, const uint64_t c,
+                        uint64_t *sum, uint64_t *carry) {
+    uint64_t t = a ^ b;
+    *sum = t ^ c;
+    *carry = (a & b) | (t & c);
+}
+
+// Steps one word, 64 cells, of a two-state board. The eight neighbor words
+// are summed with an adder tree into four bit planes holding each cell's
+// count.
+static inline uint64_t packed_word(const uint64_t *up, const uint64_t *mid,
+                                   const uint64_t *down, const int w,
+                                   const uint16_t birth,
+                                   const uint16_t survive) {
+    uint64_t s_up, c_up, s_mid, c_mid, s_down, c_down, k1, k2, t0, t1;
+    uint64_t b[4], born, stays;
+
+    add3(west_word(up, w), up[w], east_word(up, w), &s_up, &c_up);
+    add3(west_word(down, w), down[w], east_word(down, w), &s_down, &c_down);
+    s_mid = west_word(mid, w) ^ east_word(mid, w);
+    c_mid = west_word(mid, w) & east_word(mid, w);
+
+    add3(s_up, s_mid, s_down, &b[0], &k1);
+    add3(c_up, c_mid, c_down, &t0, &t1);
+    b[1] = k1 ^ t0;
+    k2 = k1 & t0;
+    b[2] = t1 ^ k2;
+    b[3] = t1 & k2;
+
+    born = stays = 0;
+    for (int n = 0; n <= 8; n++) {
+        if (birth & (1 << n)) {
+            born |= count_is(b, n);
+        }
+        if (survive & (1 << n)) {
+            stays |= count_is(b, n);
+        }
+    }
+
+    return (born & ~mid[w]) | (stays & mid[w]);
+}
+
+// Steps a tile of a two-state board, one word wide, and returns its flags.
+int next_gen_tile_packed(const Grid *g, Board *next, const CA *ca,
+                         const int top, const int w) {
+    const int bottom = top + TILE_SIZE < g->rows ? top + TILE_SIZE : g->rows;
+    const int words = (g->cols + 63) / 64;
+    const int last_bits = g->cols - (words - 1) * 64;
+    const uint64_t mask =
+        w == words - 1 ? ~(uint64_t)0 >> (64 - last_bits) : ~(uint64_t)0;
+    uint16_t birth, survive;
+    uint64_t cells = 0;
+    uint64_t *out = NULL;
+    int flags = 0;
+
+    life_masks(ca, &birth, &survive);
+
+    for (int i = top; i < bottom; i++) {
+        const uint64_t *mid = grid_bits(g, i);
+
+        out = board_bits(next, i);
+        cells = packed_word(grid_bits(g, i - 1), mid, grid_bits(g, i + 1), w,
+                            birth, survive) &
+                mask;
+
+        // The bit past the last column is halo.
+        if (cells != (mid[w] & mask)) {
+            flags |= TILE_CHANGED;
+        }
+        if (cells != (out[w] & mask)) {
+            flags |= TILE_CHANGED2;
+        }
+        out[w] = cells;
+    }
+
+    return flags;
+}
+
+// Writes the neighbor index of n cells starting at mid[0] into index, the
+// rows being read one cell past both ends. The weights of each column of
+// three are added once and slid along the row, so every cell is read three
+// times rather than eight.
+static void neighbor_index_scalar(const uint8_t *up, const uint8_t *mid,
+                                  const uint8_t *down, const int n,
+                                  const CA *ca, uint16_t *index) {
+    const int *weight = ca->weight;
+    int west = weight[up[-1]] + weight[mid[-1]] + weight[down[-1]];
+    int here = weight[up[0]] + weight[mid[0]] + weight[down[0]];
+    int east = 0;
+
+    for (int k = 0; k < n; k++) {
+        east = weight[up[k + 1]] + weight[mid[k + 1]] + weight[down[k + 1]];
+        index[k] = west + here + east - weight[mid[k]];
+        west = here;
+        here = east;
+    }
+}
+
+// Vectorized neighbor_index_scalar(), n being a multiple of the vector
+// width.
+typedef void (*IndexKernel)(const uint8_t *up, const uint8_t *mid,
+                            const uint8_t *down, const int n, const CA *ca,
+                            uint16_t *index);
+
+#ifdef X86_SIMD
+__attribute__((target("sse2"))) static void
+neighbor_index_sse2(const uint8_t *up, const uint8_t *mid, const uint8_t *down,
+                    const int n, const CA *ca, uint16_t *index) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i nb[8], count, state, weight, lo, hi;
+
+    for (int k = 0; k < n; k += 16) {
+        nb[0] = _mm_loadu_si128((const __m128i *)(up + k - 1));
+        nb[1] = _mm_loadu_si128((const __m128i *)(up + k));
+        nb[2] = _mm_loadu_si128((const __m128i *)(up + k + 1));
+        nb[3] = _mm_loadu_si128((const __m128i *)(mid + k - 1));
+        nb[4] = _mm_loadu_si128((const __m128i *)(mid + k + 1));
+        nb[5] = _mm_loadu_si128((const __m128i *)(down + k - 1));
+        nb[6] = _mm_loadu_si128((const __m128i *)(down + k));
+        nb[7] = _mm_loadu_si128((const __m128i *)(down + k + 1));
+        lo = hi = zero;
+
+        for (int s = 1; s < ca->state_amount; s++) {
+            state = _mm_set1_epi8(s);
+            weight = _mm_set1_epi16(ca->weight[s]);
+            count = zero;
+
+            // Matching lanes compare to -1, so subtracting counts them.
+            for (int q = 0; q < 8; q++) {
+                count = _mm_sub_epi8(count, _mm_cmpeq_epi8(nb[q], state));
+            }
+
+            lo = _mm_add_epi16(
+                lo, _mm_mullo_epi16(_mm_unpacklo_epi8(count, zero), weight));
+            hi = _mm_add_epi16(
+                hi, _mm_mullo_epi16(_mm_unpackhi_epi8(count, zero), weight));
+        }
+
+        _mm_storeu_si128((__m128i *)(index + k), lo);
+        _mm_storeu_si128((__m128i *)(index + k + 8), hi);
+    }
+}
+
+__attribute__((target("avx2"))) static void
+neighbor_index_avx2(const uint8_t *up, const uint8_t *mid, const uint8_t *down,
+                    const int n, const CA *ca, uint16_t *index) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i nb[8], count, state, weight, lo, hi;
+
+    for (int k = 0; k < n; k += 32) {
+        nb[0] = _mm256_loadu_si256((const __m256i *)(up + k - 1));
+        nb[1] = _mm256_loadu_si256((const __m256i *)(up + k));
+        nb[2] = _mm256_loadu_si256((const __m256i *)(up + k + 1));
+        nb[3] = _mm256_loadu_si256((const __m256i *)(mid + k - 1));
+        nb[4] = _mm256_loadu_si256((const __m256i *)(mid + k + 1));
+        nb[5] = _mm256_loadu_si256((const __m256i *)(down + k - 1));
+        nb[6] = _mm256_loadu_si256((const __m256i *)(down + k));
+        nb[7] = _mm256_loadu_si256((const __m256i *)(down + k + 1));
+        lo = hi = zero;
+
+        for (int s = 1; s < ca->state_amount; s++) {
+            state = _mm256_set1_epi8(s);
+            weight = _mm256_set1_epi16(ca->weight[s]);
+            count = zero;
+
+            for (int q = 0; q < 8; q++) {
+                count =
+                    _mm256_sub_epi8(count, _mm256_cmpeq_epi8(nb[q], state));
+            }
+
+            lo = _mm256_add_epi16(
+                lo, _mm256_mullo_epi16(
+                        _mm256_cvtepu8_epi16(_mm256_castsi256_si128(count)),
+                        weight));
+            hi = _mm256_add_epi16(
+                hi, _mm256_mullo_epi16(
+                        _mm256_cvtepu8_epi16(
+                            _mm256_extracti128_si256(count, 1)),
+                        weight));
+        }
+
+        _mm256_storeu_si256((__m256i *)(index + k), lo);
+        _mm256_storeu_si256((__m256i *)(index + k + 16), hi);
+    }
+}
+
+__attribute__((target("avx512f,avx512bw"))) static void
+neighbor_index_avx512(const uint8_t *up, const uint8_t *mid,
+                      const uint8_t *down, const int n, const CA *ca,
+                      uint16_t *index) {
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i one = _mm512_set1_epi8(1);
+    __m512i nb[8], count, state, weight, lo, hi;
+
+    for (int k = 0; k < n; k += 64) {
+        nb[0] = _mm512_loadu_si512(up + k - 1);
+        nb[1] = _mm512_loadu_si512(up + k);
+        nb[2] = _mm512_loadu_si512(up + k + 1);
+        nb[3] = _mm512_loadu_si512(mid + k - 1);
+        nb[4] = _mm512_loadu_si512(mid + k + 1);
+        nb[5] = _mm512_loadu_si512(down + k - 1);
+        nb[6] = _mm512_loadu_si512(down + k);
+        nb[7] = _mm512_loadu_si512(down + k + 1);
+        lo = hi = zero;
+
+        for (int s = 1; s < ca->state_amount; s++) {
+            state = _mm512_set1_epi8(s);
+            weight = _mm512_set1_epi16(ca->weight[s]);
+            count = zero;
+
+            for (int q = 0; q < 8; q++) {
+                count = _mm512_mask_add_epi8(
+                    count, _mm512_cmpeq_epi8_mask(nb[q], state), count, one);
+            }
+
+            lo = _mm512_add_epi16(
+                lo, _mm512_mullo_epi16(
+                        _mm512_cvtepu8_epi16(_mm512_castsi512_si256(count)),
+                        weight));
+            hi = _mm512_add_epi16(
+                hi, _mm512_mullo_epi16(
+                        _mm512_cvtepu8_epi16(
+                            _mm512_extracti64x4_epi64(count, 1)),
+                        weight));
+        }
+
+        _mm512_storeu_si512(index + k, lo);
+        _mm512_storeu_si512(index + k + 32, hi);
+    }
+}
+#endif
+
+// Supported kernels, widest first.
+static IndexKernel index_kernels[3];
+static int index_lanes[3];
+static int index_kernel_amount = 0;
+static pthread_once_t index_kernel_once = PTHREAD_ONCE_INIT;
+
+static void select_index_kernels(void) {
+#ifdef X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw")) {
+        index_kernels[index_kernel_amount] = neighbor_index_avx512;
+        index_lanes[index_kernel_amount++] = 64;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        index_kernels[index_kernel_amount] = neighbor_index_avx2;
+        index_lanes[index_kernel_amount++] = 32;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        index_kernels[index_kernel_amount] = neighbor_index_sse2;
+        index_lanes[index_kernel_amount++] = 16;
+    }
+#endif
+}
+
+// Neighbor index of n cells, through the widest SIMD kernels that fit and
+// the scalar one for the rest.
+static void neighbor_index(const uint8_t *up, const uint8_t *mid,
+                           const uint8_t *down, const int n, const CA *ca,
+                           uint16_t *index) {
+    int j = 0;
+    int m = 0;
+
+    pthread_once(&index_kernel_once, select_index_kernels);
+
+    for (int k = 0; k < index_kernel_amount; k++) {
+        m = (n - j) / index_lanes[k] * index_lanes[k];
+        if (m > 0) {
+            index_kernels[k](up + j, mid + j, down + j, m, ca, index + j);
+            j += m;
+        }
+    }
+
+    neighbor_index_scalar(up + j, mid + j, down + j, n - j, ca, index + j);
+}
+
+// Steps a tile of a byte board and returns its flags.
+int next_gen_tile_bytes(const Grid *g, Board *next, const CA *ca,
+                        const int top, const int left) {
+    const int bottom = top + TILE_SIZE < g->rows ? top + TILE_SIZE : g->rows;
+    const int right = left + TILE_SIZE < g->cols ? left + TILE_SIZE : g->cols;
+    const int n = right - left;
+    uint8_t cells[TILE_SIZE];
+    uint16_t index[TILE_SIZE];
+    uint8_t *out = NULL;
+    int flags = 0;
+
+    for (int i = top; i < bottom; i++) {
+        const uint8_t *mid = grid_row(g, i) + left;
+
+        out = board_row(next, i) + left;
+        neighbor_index(grid_row(g, i - 1) + left, mid,
+                       grid_row(g, i + 1) + left, n, ca, index);
+        for (int c = 0; c < n; c++) {
+            cells[c] = ca->table[mid[c]][index[c]];
+        }
+
+        if (memcmp(cells, mid, n) != 0) {
+            flags |= TILE_CHANGED;
+        }
+        if (memcmp(cells, out, n) != 0) {
+            flags |= TILE_CHANGED2;
+        }
+        memcpy(out, cells, n);
+    }
+
+    return flags;
+}
+
+// Writes one tile of the generation after g into next, and its flags into
+// g->next_tiles.
+void next_gen_tile(Grid *g, Board *next, const CA *ca, const int tile) {
+    const int top = tile / g->tile_cols * TILE_SIZE;
+    const int left = tile % g->tile_cols * TILE_SIZE;
+    int flags = 0;
+
+    if (g->packed && ca->state_amount == 2) {
+        flags = next_gen_tile_packed(g, next, ca, top, left / 64);
+    } else {
+        flags = next_gen_tile_bytes(g, next, ca, top, left);
+    }
+
+    // The back board of an edited tile isn't the generation before the
+    // edited cells, so it can't be told apart from an oscillation yet.
+    if (g->tiles[tile] & TILE_EDITED) {
+        flags |= TILE_CHANGED2;
+    }
+
+    g->next_tiles[tile] = flags;
+}
 
-typedef int Board[BOARD_SIZE][BOARD_SIZE];
+static Pool pool = {
+    .thread_amount = 1,
+    .run = PTHREAD_MUTEX_INITIALIZER,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+static void run_band(const int band) {
+    const int begin = pool.items * band / pool.bands;
+    const int end = pool.items * (band + 1) / pool.bands;
+
+    for (int i = begin; i < end; i++) {
+        pool.task(pool.ctx, i);
+    }
+}
+
+static void *pool_worker(void *arg) {
+    const int band = (int)(intptr_t)arg;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+        while (!pool.quit && pool.job == seen) {
+            pthread_cond_wait(&pool.work, &pool.lock);
+        }
+        if (pool.quit) {
+            break;
+        }
+        seen = pool.job;
+
+        if (band < pool.bands) {
+            pthread_mutex_unlock(&pool.lock);
+            run_band(band);
+            pthread_mutex_lock(&pool.lock);
+        }
+
+        if (--pool.pending == 0) {
+            pthread_cond_signal(&pool.done);
+        }
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    return NULL;
+}
+
+int cpu_count(void) {
+#ifdef _WIN32
+    const char *n = getenv("NUMBER_OF_PROCESSORS");
+    return n != NULL ? atoi(n) : 1;
+#else
+    return sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+static void join_workers(void) {
+    pthread_mutex_lock(&pool.lock);
+    pool.quit = true;
+    pthread_cond_broadcast(&pool.work);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (int i = 1; i < pool.thread_amount; i++) {
+        pthread_join(pool.threads[i], NULL);
+    }
+
+    // Workers started later begin with no job seen.
+    pool.thread_amount = 1;
+    pool.quit = false;
+    pool.job = 0;
+}
+
+void stop_pool(void) {
+    pthread_mutex_lock(&pool.run);
+    join_workers();
+    pthread_mutex_unlock(&pool.run);
+}
+
+// Steps grids with `threads` threads, from 1 to the number of cores. Zero or
+// less means all of them.
+void start_pool(int threads) {
+    if (threads < 1 || threads > cpu_count()) {
+        threads = cpu_count();
+    }
+    if (threads > MAX_THREADS) {
+        threads = MAX_THREADS;
+    }
+
+    pthread_mutex_lock(&pool.run);
+    join_workers();
+
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&pool.threads[i], NULL, pool_worker,
+                           (void *)(intptr_t)i) != 0) {
+            perror("Error starting worker thread");
+            break;
+        }
+        pool.thread_amount++;
+    }
+    pthread_mutex_unlock(&pool.run);
+}
+
+// Runs task on items 0 to items - 1 across the pool. Jobs started while
+// another thread has the pool, and single items, run right here.
+void parallel_for(const int items, Task task, void *ctx) {
+    const int bands = items < pool.thread_amount ? items : pool.thread_amount;
+
+    if (bands < 2 || pthread_mutex_trylock(&pool.run) != 0) {
+        for (int i = 0; i < items; i++) {
+            task(ctx, i);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.task = task;
+    pool.ctx = ctx;
+    pool.items = items;
+    pool.bands = bands;
+    pool.pending = pool.thread_amount - 1;
+    pool.job++;
+    pthread_cond_broadcast(&pool.work);
+    pthread_mutex_unlock(&pool.lock);
+
+    run_band(0);
+
+    pthread_mutex_lock(&pool.lock);
+    while (pool.pending > 0) {
+        pthread_cond_wait(&pool.done, &pool.lock);
+    }
+    pthread_mutex_unlock(&pool.lock);
+    pthread_mutex_unlock(&pool.run);
+}
+
+// Counts the live cells of one generation of a chunk and finds the edges
+// they touch.
+static void scan_chunk(Chunk *c, const int gen) {
+    uint8_t(*cells)[TILE_SIZE] = c->cells[gen];
+    const int last = TILE_SIZE - 1;
+    int population = 0;
+    bool top = false, bottom = false, left = false, right = false;
+
+    for (int i = 0; i < TILE_SIZE; i++) {
+        for (int j = 0; j < TILE_SIZE; j++) {
+            population += cells[i][j] != 0;
+        }
+        top |= cells[0][i] != 0;
+        bottom |= cells[last][i] != 0;
+        left |= cells[i][0] != 0;
+        right |= cells[i][last] != 0;
+    }
+
+    c->population = population;
+    c->edges = (cells[0][0] != 0) | top << 1 | (cells[0][last] != 0) << 2 |
+               left << 3 | right << 4 | (cells[last][0] != 0) << 5 |
+               bottom << 6 | (cells[last][last] != 0) << 7;
+}
+
+typedef struct {
+    Plane *plane;
+    const CA *ca;
+} ChunkStep;
+
+// Steps one chunk through a copy with a ring of the cells its neighbors
+// hold, dead where there is no neighbor.
+static void step_chunk_task(void *ctx, const int item) {
+    const ChunkStep *step = ctx;
+    const Plane *p = step->plane;
+    const CA *ca = step->ca;
+    Chunk *c = p->chunks[item];
+    const Chunk *around = NULL;
+    uint8_t halo[TILE_SIZE + 2][TILE_SIZE + 2] = {{0}};
+    uint8_t(*next)[TILE_SIZE] = c->cells[!p->front];
+    uint16_t index[TILE_SIZE];
+    bool changed = false;
+
+    for (int i = 0; i < TILE_SIZE; i++) {
+        memcpy(&halo[i + 1][1], c->cells[p->front][i], TILE_SIZE);
+    }
+    for (int d = 0; d < 8; d++) {
+        const int dy = chunk_dy[d];
+        const int dx = chunk_dx[d];
+        const int row = dy < 0 ? 0 : dy == 0 ? 1 : TILE_SIZE + 1;
+        const int col = dx < 0 ? 0 : dx == 0 ? 1 : TILE_SIZE + 1;
+        const int rows = dy == 0 ? TILE_SIZE : 1;
+        const int cols = dx == 0 ? TILE_SIZE : 1;
+
+        around = find_chunk(p, c->cx + dx, c->cy + dy);
+        if (around == NULL) {
+            continue;
+        }
+        for (int i = 0; i < rows; i++) {
+            memcpy(&halo[row + i][col],
+                   &around->cells[p->front][dy < 0 ? TILE_SIZE - 1 : i]
+                                           [dx < 0 ? TILE_SIZE - 1 : 0],
+                   cols);
+        }
+    }
+
+    for (int i = 1; i <= TILE_SIZE; i++) {
+        neighbor_index(&halo[i - 1][1], &halo[i][1], &halo[i + 1][1],
+                       TILE_SIZE, ca, index);
+        for (int j = 0; j < TILE_SIZE; j++) {
+            next[i - 1][j] = ca->table[halo[i][j + 1]][index[j]];
+            changed |= next[i - 1][j] != halo[i][j + 1];
+        }
+    }
+
+    c->changed = changed;
+    scan_chunk(c, !p->front);
+}
+
+// Moves the plane forward a generation. Dead space next to live cells on
+// the edge of a chunk gets a chunk of its own first. Returns false when out
+// of memory.
+bool step_plane(Plane *p, const CA *ca) {
+    const size_t amount = p->chunk_amount;
+    ChunkStep step = {p, ca};
+    Chunk *c = NULL;
+
+    for (size_t i = 0; i < amount; i++) {
+        c = p->chunks[i];
+        for (int d = 0; d < 8; d++) {
+            if (((c->edges >> d) & 1) &&
+                add_chunk(p, c->cx + chunk_dx[d], c->cy + chunk_dy[d]) ==
+                    NULL) {
+                return false;
+            }
+        }
+    }
+
+    parallel_for((int)p->chunk_amount, step_chunk_task, &step);
+    p->front = !p->front;
+    return true;
+}
+
+// Frees the chunks that died out, unless live cells of a neighbor face them
+// and would only bring them back.
+static void drop_dead_chunks(Plane *p) {
+    const Chunk *around = NULL;
+    Chunk *c = NULL;
+    size_t kept = 0;
+    bool faced = false;
+
+    for (size_t i = 0; i < p->chunk_amount; i++) {
+        c = p->chunks[i];
+        faced = false;
+        for (int d = 0; d < 8 && c->population == 0 && !faced; d++) {
+            around = find_chunk(p, c->cx + chunk_dx[d], c->cy + chunk_dy[d]);
+            faced = around != NULL && ((around->edges >> (7 - d)) & 1);
+        }
+
+        if (c->population == 0 && !faced) {
+            unlink_chunk(p, c);
+            free(c);
+        } else {
+            p->chunks[kept++] = c;
+        }
+    }
+
+    p->chunk_amount = kept;
+}
+
+// Writes the tiles of the board edited since the last generation to the
+// chunks under them.
+static bool push_edits(Grid *g) {
+    Plane *p = &g->plane;
+    Chunk *c = NULL;
+    int state = 0;
+
+    for (int tr = 0; tr < g->tile_rows; tr++) {
+        for (int tc = 0; tc < g->tile_cols; tc++) {
+            const int tile = tr * g->tile_cols + tc;
+            const int top = tr * TILE_SIZE;
+            const int left = tc * TILE_SIZE;
+            const int rows = g->rows - top < TILE_SIZE ? g->rows - top
+                                                       : TILE_SIZE;
+            const int cols = g->cols - left < TILE_SIZE ? g->cols - left
+                                                        : TILE_SIZE;
+
+            if (!(g->tiles[tile] & TILE_EDITED)) {
+                continue;
+            }
+
+            c = find_chunk(p, tc, tr);
+            for (int i = 0; i < rows; i++) {
+                for (int j = 0; j < cols; j++) {
+                    state = get_cell(g, top + i, left + j);
+                    if (state && c == NULL &&
+                        (c = add_chunk(p, tc, tr)) == NULL) {
+                        return false;
+                    }
+                    if (c != NULL) {
+                        c->cells[p->front][i][j] = state;
+                    }
+                }
+            }
+
+            if (c != NULL) {
+                scan_chunk(c, p->front);
+            }
+            g->tiles[tile] &= ~TILE_EDITED;
+        }
+    }
+
+    return true;
+}
+
+// Copies the chunks under the board to it, all of them or those that
+// changed, and flags the tiles accordingly.
+static void pull_window(Grid *g, const bool all) {
+    const Plane *p = &g->plane;
+    const Chunk *c = NULL;
+
+    for (int tr = 0; tr < g->tile_rows; tr++) {
+        for (int tc = 0; tc < g->tile_cols; tc++) {
+            const int tile = tr * g->tile_cols + tc;
+            const int top = tr * TILE_SIZE;
+            const int left = tc * TILE_SIZE;
+            const int rows = g->rows - top < TILE_SIZE ? g->rows - top
+                                                       : TILE_SIZE;
+            const int cols = g->cols - left < TILE_SIZE ? g->cols - left
+                                                        : TILE_SIZE;
+
+            c = find_chunk(p, tc, tr);
+            if (!all && (c == NULL || !c->changed)) {
+                g->tiles[tile] &= TILE_LASTING;
+                continue;
+            }
+
+            for (int i = 0; i < rows; i++) {
+                for (int j = 0; j < cols; j++) {
+                    put_cell(g, top + i, left + j,
+                             c != NULL ? c->cells[p->front][i][j] : 0);
+                }
+            }
+            g->tiles[tile] = TILE_CHANGED | TILE_LASTING;
+        }
+    }
+}
+
+// Steps the plane under an Unbounded grid and shows the result on the
+// board.
+static void next_gen_plane(Grid *g, const CA *ca) {
+    if (!push_edits(g) || !step_plane(&g->plane, ca)) {
+        perror("Error allocating chunk");
+        return;
+    }
+
+    g->active_amount = g->plane.chunk_amount;
+    pull_window(g, false);
+    drop_dead_chunks(&g->plane);
+}
+
+// Switches the grid to another boundary, keeping the cells on the board.
+// Returns false for rules that bring dead space to life, which can't run
+// on an unbounded plane.
+bool set_boundary(Grid *g, const CA *ca, const Boundary boundary) {
+    if (boundary == Unbounded && ca->table[0][0] != 0) {
+        return false;
+    }
+
+    g->boundary = boundary;
+    clear_plane(&g->plane);
+    touch_grid(g);
+    return true;
+}
+
+// Decides whether a tile has to be stepped. Sleeping tiles get the flags
+// they will have next generation.
+static bool tile_awake(Grid *g, const int tile) {
+    const int row = tile / g->tile_cols;
+    const int col = tile % g->tile_cols;
+    int around = 0;
+
+    for (int i = row - 1; i <= row + 1; i++) {
+        for (int j = col - 1; j <= col + 1; j++) {
+            around |= g->tiles[((i + g->tile_rows) % g->tile_rows) *
+                                   g->tile_cols +
+                               (j + g->tile_cols) % g->tile_cols];
+        }
+    }
+
+    if (!(around & TILE_CHANGED)) {
+        // Still life: the back board already holds the same cells.
+        g->next_tiles[tile] = 0;
+        return false;
+    }
+    if (g->period2 && !(around & TILE_CHANGED2)) {
+        // Period 2: the back board holds the cells of two generations ago,
+        // which are the next ones.
+        g->next_tiles[tile] = g->tiles[tile] & TILE_CHANGED;
+        return false;
+    }
+
+    return true;
+}
+
+typedef struct {
+    Grid *grid;
+    Board *next;
+    const CA *ca;
+} TileStep;
+
+static void step_tile_task(void *ctx, const int item) {
+    TileStep *step = ctx;
+    next_gen_tile(step->grid, step->next, step->ca, step->grid->active[item]);
+}
+
+void next_gen(Grid *g, const CA *ca) {
+    Board *next = back_board(g);
+    const int tiles = g->tile_rows * g->tile_cols;
+    TileStep step = {g, next, ca};
+    uint8_t *flags = NULL;
+
+    if (g->boundary == Unbounded) {
+        next_gen_plane(g, ca);
+        return;
+    }
+
+    if (next->cells == NULL &&
+        !alloc_board(next, g->rows, g->cols, g->packed)) {
+        perror("Error allocating board");
+        return;
+    }
+
+    refresh_halo(g);
+
+    g->active_amount = 0;
+    for (int i = 0; i < tiles; i++) {
+        if (tile_awake(g, i)) {
+            g->active[g->active_amount++] = i;
+        }
+    }
+
+    parallel_for(g->active_amount, step_tile_task, &step);
+
+    // Tiles that changed stay flagged for whoever hasn't looked at them.
+    for (int i = 0; i < tiles; i++) {
+        g->next_tiles[i] |= g->next_tiles[i] & TILE_CHANGED
+                                ? TILE_LASTING
+                                : g->tiles[i] & TILE_LASTING;
+    }
+
+    flags = g->tiles;
+    g->tiles = g->next_tiles;
+    g->next_tiles = flags;
+    g->front = !g->front;
+}
+
+static HashLife hashlife = {
+    .budget = HASHLIFE_BUDGET,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static size_t quad_hash(const Quad *nw, const Quad *ne, const Quad *sw,
+                        const Quad *se) {
+    uint64_t h = (uintptr_t)nw;
+
+    h = h * 0x9E3779B97F4A7C15 + (uintptr_t)ne;
+    h = h * 0x9E3779B97F4A7C15 + (uintptr_t)sw;
+    h = h * 0x9E3779B97F4A7C15 + (uintptr_t)se;
+    return h ^ (h >> 29);
+}
+
+static bool resize_buckets(HashLife *hl, const size_t amount) {
+    Quad **buckets = calloc(amount, sizeof(Quad *));
+    Quad *q = NULL;
+    Quad *next = NULL;
+    size_t h = 0;
+
+    if (buckets == NULL) {
+        return false;
+    }
+
+    for (size_t i = 0; i < hl->bucket_amount; i++) {
+        for (q = hl->buckets[i]; q != NULL; q = next) {
+            next = q->next;
+            h = quad_hash(q->nw, q->ne, q->sw, q->se) & (amount - 1);
+            q->next = buckets[h];
+            buckets[h] = q;
+        }
+    }
+
+    free(hl->buckets);
+    hl->buckets = buckets;
+    hl->bucket_amount = amount;
+    return true;
+}
+
+// The unique node with these quadrants.
+static Quad *join(HashLife *hl, Quad *nw, Quad *ne, Quad *sw, Quad *se) {
+    size_t h = quad_hash(nw, ne, sw, se);
+    Quad *q = NULL;
+
+    for (q = hl->buckets[h & (hl->bucket_amount - 1)]; q != NULL;
+         q = q->next) {
+        if (q->nw == nw && q->ne == ne && q->sw == sw && q->se == se) {
+            return q;
+        }
+    }
+
+    if (hl->node_amount >= hl->bucket_amount) {
+        resize_buckets(hl, hl->bucket_amount * 2);
+    }
+
+    q = calloc(1, sizeof(Quad));
+    if (q == NULL) {
+        perror("Error allocating HashLife node");
+        exit(1);
+    }
+
+    q->nw = nw;
+    q->ne = ne;
+    q->sw = sw;
+    q->se = se;
+    q->level = nw->level + 1;
+    q->population =
+        nw->population + ne->population + sw->population + se->population;
+    h &= hl->bucket_amount - 1;
+    q->next = hl->buckets[h];
+    hl->buckets[h] = q;
+    hl->node_amount++;
+
+    return q;
+}
+
+static Quad *empty_quad(HashLife *hl, const int level) {
+    Quad *e = NULL;
+
+    if (level == 0) {
+        return &hl->cells[0];
+    }
+    if (hl->empty[level] == NULL) {
+        e = empty_quad(hl, level - 1);
+        hl->empty[level] = join(hl, e, e, e, e);
+    }
+    return hl->empty[level];
+}
+
+static Quad *center(HashLife *hl, const Quad *q) {
+    return join(hl, q->nw->se, q->ne->sw, q->sw->ne, q->se->nw);
+}
+
+// Center 2x2 cells of a 4x4 node one generation later.
+static Quad *advance_leaf(HashLife *hl, const Quad *q) {
+    int cells[4][4];
+    int n = 0;
+    const Quad *quads[2][2] = {{q->nw, q->ne}, {q->sw, q->se}};
+    Quad *out[4];
+
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            const Quad *sub = quads[i / 2][j / 2];
+            const Quad *cell[2][2] = {{sub->nw, sub->ne}, {sub->sw, sub->se}};
+            cells[i][j] = cell[i % 2][j % 2]->population;
+        }
+    }
+
+    for (int i = 1; i < 3; i++) {
+        for (int j = 1; j < 3; j++) {
+            n = cells[i - 1][j - 1] + cells[i - 1][j] + cells[i - 1][j + 1] +
+                cells[i][j - 1] + cells[i][j + 1] + cells[i + 1][j - 1] +
+                cells[i + 1][j] + cells[i + 1][j + 1];
+            out[(i - 1) * 2 + (j - 1)] =
+                &hl->cells[((cells[i][j] ? hl->survive : hl->birth) >> n) & 1];
+        }
+    }
+
+    return join(hl, out[0], out[1], out[2], out[3]);
+}
+
+// Center half of q, 2^step generations later. step is at most level - 2.
+static Quad *advance(HashLife *hl, Quad *q, const int step) {
+    Quad *sub[3][3], *res[3][3], *r[4];
+    const bool full = step == q->level - 2;
+
+    if (q->population == 0) {
+        return empty_quad(hl, q->level - 1);
+    }
+    if (q->result != NULL && q->result_step == step) {
+        return q->result;
+    }
+    if (q->level == 2) {
+        q->result = advance_leaf(hl, q);
+        q->result_step = step;
+        return q->result;
+    }
+
+    // Nine overlapping squares of half the size...
+    sub[0][0] = q->nw;
+    sub[0][1] = join(hl, q->nw->ne, q->ne->nw, q->nw->se, q->ne->sw);
+    sub[0][2] = q->ne;
+    sub[1][0] = join(hl, q->nw->sw, q->nw->se, q->sw->nw, q->sw->ne);
+    sub[1][1] = center(hl, q);
+    sub[1][2] = join(hl, q->ne->sw, q->ne->se, q->se->nw, q->se->ne);
+    sub[2][0] = q->sw;
+    sub[2][1] = join(hl, q->sw->ne, q->se->nw, q->sw->se, q->se->sw);
+    sub[2][2] = q->se;
+
+    // ... whose centers are moved half the way at full speed, or just
+    // taken as they are when stepping slower...
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            res[i][j] = full ? advance(hl, sub[i][j], step - 1)
+                             : center(hl, sub[i][j]);
+        }
+    }
+
+    // ... and regrouped into four squares that cover the rest of the way.
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+            r[i * 2 + j] = advance(
+                hl,
+                join(hl, res[i][j], res[i][j + 1], res[i + 1][j],
+                     res[i + 1][j + 1]),
+                full ? step - 1 : step);
+        }
+    }
+
+    q->result = join(hl, r[0], r[1], r[2], r[3]);
+    q->result_step = step;
+    return q->result;
+}
+
+// Grows the root one level, keeping its cells in the center.
+static void expand_root(HashLife *hl) {
+    Quad *q = hl->root;
+    Quad *e = empty_quad(hl, q->level - 1);
+
+    hl->top -= (int64_t)1 << (q->level - 1);
+    hl->left -= (int64_t)1 << (q->level - 1);
+    hl->root = join(hl, join(hl, e, e, e, q->nw), join(hl, e, e, q->ne, e),
+                    join(hl, e, q->sw, e, e), join(hl, q->se, e, e, e));
+}
+
+static void mark_quad(Quad *q) {
+    if (q == NULL || q->marked) {
+        return;
+    }
+    q->marked = true;
+    mark_quad(q->nw);
+    mark_quad(q->ne);
+    mark_quad(q->sw);
+    mark_quad(q->se);
+}
+
+// Frees every node the root does not use, and the results that pointed to
+// them.
+static void collect_garbage(HashLife *hl) {
+    Quad **link = NULL;
+    Quad *q = NULL;
+
+    mark_quad(hl->root);
+    for (int i = 0; i < 64; i++) {
+        mark_quad(hl->empty[i]);
+    }
+
+    for (size_t i = 0; i < hl->bucket_amount; i++) {
+        for (q = hl->buckets[i]; q != NULL; q = q->next) {
+            if (q->result != NULL && !q->result->marked) {
+                q->result = NULL;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < hl->bucket_amount; i++) {
+        for (link = &hl->buckets[i]; *link != NULL;) {
+            q = *link;
+            if (q->marked) {
+                q->marked = false;
+                link = &q->next;
+            } else {
+                *link = q->next;
+                free(q);
+                hl->node_amount--;
+            }
+        }
+    }
+
+    hl->cells[0].marked = hl->cells[1].marked = false;
+}
+
+void free_hashlife(HashLife *hl) {
+    hl->root = NULL;
+    memset(hl->empty, 0, sizeof(hl->empty));
+    collect_garbage(hl);
+    free(hl->buckets);
+    hl->buckets = NULL;
+    hl->bucket_amount = 0;
+}
+
+static Quad *chunk_quad(HashLife *hl, uint8_t (*cells)[TILE_SIZE],
+                        const int level, const int row, const int col) {
+    const int half = level > 0 ? 1 << (level - 1) : 0;
+
+    if (level == 0) {
+        return &hl->cells[cells[row][col] != 0];
+    }
+
+    return join(hl, chunk_quad(hl, cells, level - 1, row, col),
+                chunk_quad(hl, cells, level - 1, row, col + half),
+                chunk_quad(hl, cells, level - 1, row + half, col),
+                chunk_quad(hl, cells, level - 1, row + half, col + half));
+}
+
+// Moves the chunks with a coordinate below `at` to the front, returns how
+// many there are.
+static size_t split_chunks(Chunk **chunks, const size_t amount,
+                           const bool by_row, const int64_t at) {
+    Chunk *c = NULL;
+    size_t before = 0;
+
+    for (size_t i = 0; i < amount; i++) {
+        if ((by_row ? chunks[i]->cy : chunks[i]->cx) < at) {
+            c = chunks[before];
+            chunks[before++] = chunks[i];
+            chunks[i] = c;
+        }
+    }
+    return before;
+}
+
+// The node of a 2^level square of the plane whose top left chunk is (cy,
+// cx), and that holds the chunks in chunks[0, amount).
+static Quad *plane_quad(HashLife *hl, Chunk **chunks, const size_t amount,
+                        const int front, const int level, const int64_t cy,
+                        const int64_t cx) {
+    int64_t half = 0;
+    size_t north = 0, nw = 0, sw = 0;
+
+    if (amount == 0) {
+        return empty_quad(hl, level);
+    }
+    if (((int64_t)1 << level) == TILE_SIZE) {
+        return chunk_quad(hl, chunks[0]->cells[front], level, 0, 0);
+    }
+
+    half = ((int64_t)1 << level) / TILE_SIZE / 2;
+    north = split_chunks(chunks, amount, true, cy + half);
+    nw = split_chunks(chunks, north, false, cx + half);
+    sw = split_chunks(chunks + north, amount - north, false, cx + half);
+
+    return join(hl, plane_quad(hl, chunks, nw, front, level - 1, cy, cx),
+                plane_quad(hl, chunks + nw, north - nw, front, level - 1, cy,
+                           cx + half),
+                plane_quad(hl, chunks + north, sw, front, level - 1,
+                           cy + half, cx),
+                plane_quad(hl, chunks + north + sw, amount - north - sw,
+                           front, level - 1, cy + half, cx + half));
+}
+
+// Makes the root the smallest square of chunks around the plane.
+static void build_plane(HashLife *hl, Plane *p) {
+    int64_t top = 0, left = 0, bottom = 0, right = 0;
+    int level = 0;
+
+    for (size_t i = 0; i < p->chunk_amount; i++) {
+        const Chunk *c = p->chunks[i];
+
+        if (i == 0 || c->cy < top) {
+            top = c->cy;
+        }
+        if (i == 0 || c->cx < left) {
+            left = c->cx;
+        }
+        if (i == 0 || c->cy > bottom) {
+            bottom = c->cy;
+        }
+        if (i == 0 || c->cx > right) {
+            right = c->cx;
+        }
+    }
+
+    while (((int64_t)1 << level) < TILE_SIZE ||
+           ((int64_t)1 << level) / TILE_SIZE <= bottom - top ||
+           ((int64_t)1 << level) / TILE_SIZE <= right - left) {
+        level++;
+    }
+
+    hl->root = plane_quad(hl, p->chunks, p->chunk_amount, p->front, level,
+                          top, left);
+    hl->top = top * TILE_SIZE;
+    hl->left = left * TILE_SIZE;
+}
+
+// Writes the live cells of q, whose top left cell is at (top, left), to the
+// plane.
+static bool store_plane_quad(const Quad *q, Plane *p, const int64_t top,
+                             const int64_t left) {
+    const int64_t half = q->level > 0 ? (int64_t)1 << (q->level - 1) : 0;
+
+    if (q->population == 0) {
+        return true;
+    }
+    if (q->level == 0) {
+        return set_plane_cell(p, top, left, 1);
+    }
+
+    return store_plane_quad(q->nw, p, top, left) &&
+           store_plane_quad(q->ne, p, top, left + half) &&
+           store_plane_quad(q->sw, p, top + half, left) &&
+           store_plane_quad(q->se, p, top + half, left + half);
+}
+
+// Moves the plane of an Unbounded g forward n generations with HashLife.
+// Returns false, leaving g as it was, if the board isn't Unbounded, since
+// HashLife has no edges to wrap around or stop at, or if the rule can't run
+// on this engine: it needs two states and dead cells with no live neighbors
+// to stay dead. Also if the pattern spreads too far for HASHLIFE_MAX_LEVEL.
+bool hashlife_jump(HashLife *hl, Grid *g, const CA *ca, uint64_t n) {
+    uint16_t birth, survive;
+    int step = 0;
+
+    life_masks(ca, &birth, &survive);
+    if (g->boundary != Unbounded || ca->state_amount != 2 || (birth & 1)) {
+        return false;
+    }
+
+    // Results are only valid for the rule they were computed with.
+    if (hl->buckets != NULL && (hl->birth != birth || hl->survive != survive)) {
+        free_hashlife(hl);
+    }
+    if (hl->buckets == NULL) {
+        if (!resize_buckets(hl, 1 << 16)) {
+            return false;
+        }
+        hl->cells[1].population = 1;
+        hl->birth = birth;
+        hl->survive = survive;
+    }
+
+    if (!push_edits(g)) {
+        return false;
+    }
+    build_plane(hl, &g->plane);
+
+    // Every set bit of n is a jump of 2^step generations. The root is grown
+    // until its cells sit in the middle quarter and can't outrun the half
+    // that advance() returns.
+    for (step = 0; n > 0; step++, n >>= 1) {
+        if (!(n & 1)) {
+            continue;
+        }
+
+        while (hl->root->level < step + 3 ||
+               hl->root->population != hl->root->nw->se->se->population +
+                                           hl->root->ne->sw->sw->population +
+                                           hl->root->sw->ne->ne->population +
+                                           hl->root->se->nw->nw->population) {
+            if (hl->root->level >= HASHLIFE_MAX_LEVEL) {
+                return false;
+            }
+            expand_root(hl);
+        }
+
+        hl->top += (int64_t)1 << (hl->root->level - 2);
+        hl->left += (int64_t)1 << (hl->root->level - 2);
+        hl->root = advance(hl, hl->root, step);
+
+        if (hl->node_amount * sizeof(Quad) > hl->budget) {
+            collect_garbage(hl);
+        }
+    }
+
+    clear_plane(&g->plane);
+    if (!store_plane_quad(hl->root, &g->plane, hl->top, hl->left)) {
+        perror("Error allocating chunk");
+    }
+    for (size_t i = 0; i < g->plane.chunk_amount; i++) {
+        scan_chunk(g->plane.chunks[i], g->plane.front);
+    }
+    pull_window(g, true);
+    return true;
+}
+
+// Moves g forward n generations, with HashLife when the board and rule
+// allow it, HASHLIFE_MAX_JUMP generations at a time. What HashLife can't do
+// is stepped if it's at most MAX_STEPPED generations, and left undone
+// otherwise rather than hang the caller. Returns the generations g moved.
+uint64_t jump_gen(Grid *g, const CA *ca, const uint64_t n) {
+    uint64_t done = 0;
+    uint64_t jump = 0;
+
+    if (n > 1 && pthread_mutex_trylock(&hashlife.lock) == 0) {
+        while (done < n) {
+            jump = n - done < HASHLIFE_MAX_JUMP ? n - done : HASHLIFE_MAX_JUMP;
+            if (!hashlife_jump(&hashlife, g, ca, jump)) {
+                break;
+            }
+            done += jump;
+        }
+        pthread_mutex_unlock(&hashlife.lock);
+    }
+
+    if (n - done <= MAX_STEPPED) {
+        for (; done < n; done++) {
+            next_gen(g, ca);
+        }
+    }
+    return done;
+}
+
+// Rows or columns of level k over n cells.
+static inline int level_size(const int n, const int k) {
+    return (int)(((int64_t)n + ((int64_t)1 << k) - 1) >> k);
+}
+
+void free_pyramid(Pyramid *p) {
+    for (int k = 1; k < p->level_amount; k++) {
+        free(p->levels[k]);
+    }
+    free(p->summed);
+    *p = (Pyramid){0};
+}
+
+// Makes room for the levels of g, to be summed from scratch.
+static bool reshape_pyramid(Pyramid *p, Grid *g) {
+    const int tiles = g->tile_rows * g->tile_cols;
+
+    free_pyramid(p);
+    p->rows = g->rows;
+    p->cols = g->cols;
+    p->level_amount = 1;
+    while (level_size(g->rows, p->level_amount - 1) > 1 ||
+           level_size(g->cols, p->level_amount - 1) > 1) {
+        p->levels[p->level_amount] =
+            malloc((size_t)level_size(g->rows, p->level_amount) *
+                   level_size(g->cols, p->level_amount));
+        if (p->levels[p->level_amount++] == NULL) {
+            free_pyramid(p);
+            return false;
+        }
+    }
+    p->summed = malloc(tiles * sizeof(int));
+    if (p->summed == NULL) {
+        free_pyramid(p);
+        return false;
+    }
+
+    for (int i = 0; i < tiles; i++) {
+        g->tiles[i] |= TILE_UNSUMMED;
+    }
+    return true;
+}
+
+// Square (y, x) of level k, from the up to four squares under it.
+static uint8_t sum_square(const Pyramid *p, const Grid *g, const int k,
+                          const int y, const int x) {
+    const int rows = level_size(p->rows, k - 1);
+    const int cols = level_size(p->cols, k - 1);
+    const uint8_t *under = p->levels[k - 1];
+    int sum = 0;
+    int n = 0;
+
+    for (int i = 2 * y; i < 2 * y + 2 && i < rows; i++) {
+        for (int j = 2 * x; j < 2 * x + 2 && j < cols; j++, n++) {
+            if (k == 1) {
+                sum += get_cell(g, i, j) != 0 ? 255 : 0;
+            } else {
+                sum += under[(size_t)i * cols + j];
+            }
+        }
+    }
+    return sum / n;
+}
+
+// Sums the tiles of g flagged TILE_UNSUMMED again, and the squares above
+// them, so levels cost as much to keep as the tiles that changed. Returns
+// false when out of memory.
+bool update_pyramid(Pyramid *p, Grid *g) {
+    const int tiles = g->tile_rows * g->tile_cols;
+    int tr, tc, top, left, bottom, right, cols;
+
+    if ((p->rows != g->rows || p->cols != g->cols || p->summed == NULL) &&
+        !reshape_pyramid(p, g)) {
+        return false;
+    }
+
+    p->summed_amount = 0;
+    for (int i = 0; i < tiles; i++) {
+        if (!(g->tiles[i] & TILE_UNSUMMED)) {
+            continue;
+        }
+        g->tiles[i] &= ~TILE_UNSUMMED;
+        p->summed[p->summed_amount++] = i;
+
+        tr = i / g->tile_cols;
+        tc = i % g->tile_cols;
+        for (int k = 1; k <= TILE_LEVEL && k < p->level_amount; k++) {
+            cols = level_size(p->cols, k);
+            top = (tr * TILE_SIZE) >> k;
+            left = (tc * TILE_SIZE) >> k;
+            bottom = level_size((tr + 1) * TILE_SIZE, k);
+            right = level_size((tc + 1) * TILE_SIZE, k);
+            bottom = bottom < level_size(p->rows, k) ? bottom
+                                                     : level_size(p->rows, k);
+            right = right < cols ? right : cols;
+            for (int y = top; y < bottom; y++) {
+                for (int x = left; x < right; x++) {
+                    p->levels[k][(size_t)y * cols + x] =
+                        sum_square(p, g, k, y, x);
+                }
+            }
+        }
+    }
+
+    // Squares over several tiles, once per tile under them.
+    for (int k = TILE_LEVEL + 1; k < p->level_amount; k++) {
+        cols = level_size(p->cols, k);
+        for (int i = 0; i < p->summed_amount; i++) {
+            tr = (p->summed[i] / g->tile_cols) >> (k - TILE_LEVEL);
+            tc = (p->summed[i] % g->tile_cols) >> (k - TILE_LEVEL);
+            p->levels[k][(size_t)tr * cols + tc] = sum_square(p, g, k, tr, tc);
+        }
+    }
+    return true;
+}
+
+// A gif export's frame as one byte per cell, sampling every `stride`
+// cells of boards larger than a gif can hold. The gif shows it scaled up
+// by `factor`.
+typedef struct {
+    uint8_t *cells;
+    uint8_t *last; // cells as the gif shows them after the last frame
+    uint64_t hash; // sum of cell_hash over the cells
+    int cols;
+    int rows;
+    int stride;
+    int factor;
+} GifCanvas;
+
+// Part of the hash of a canvas holding state at cell k, 0 for dead cells so
+// the hash can be kept up to date as cells change.
+static uint64_t cell_hash(const size_t k, const uint8_t state) {
+    uint64_t h = (k * STATES + state) * 0x9E3779B97F4A7C15;
+
+    if (state == 0) {
+        return 0;
+    }
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9;
+    return h ^ (h >> 32);
+}
+
+// Draws the cells of g under a rectangle of the canvas.
+static void draw_canvas(GifCanvas *canvas, const Grid *g, const ge_Rect r) {
+    uint8_t *line = NULL;
+    uint8_t state = 0;
+    size_t k = 0;
+
+    for (int y = r.y; y < r.y + r.h; y++) {
+        line = canvas->cells + (size_t)y * canvas->cols;
+        for (int x = r.x; x < r.x + r.w; x++) {
+            state = get_cell(g, y * canvas->stride, x * canvas->stride);
+            if (state != line[x]) {
+                k = (size_t)y * canvas->cols + x;
+                canvas->hash += cell_hash(k, state) - cell_hash(k, line[x]);
+                line[x] = state;
+            }
+        }
+    }
+}
+
+// Canvas cells showing board cells first to last - 1 of a row or column.
+static void cells_to_canvas(const int first, const int last, const int stride,
+                            const int size, int *from, int *to) {
+    *from = (first + stride - 1) / stride;
+    *to = (last + stride - 1) / stride;
+    if (*to > size) {
+        *to = size;
+    }
+}
+
+// Gif pixels showing a rectangle of canvas cells.
+static ge_Rect canvas_to_pixels(const GifCanvas *canvas, const ge_Rect r) {
+    const int f = canvas->factor;
+
+    return (ge_Rect){r.x * f, r.y * f, r.w * f, r.h * f};
+}
+
+// Canvas rectangles around the groups of touching tiles that changed in the
+// last generation, in gif pixels. rects, seen and stack hold a value per
+// tile.
+static int changed_rects(const Grid *g, const GifCanvas *canvas,
+                         ge_Rect *rects, uint8_t *seen, int *stack) {
+    const int tiles = g->tile_rows * g->tile_cols;
+    int top, left, bottom, right, tile, row, col, x0, x1, y0, y1;
+    int amount = 0;
+    int depth = 0;
+
+    memset(seen, 0, tiles);
+    for (int i = 0; i < tiles; i++) {
+        if (seen[i] || !(g->tiles[i] & TILE_CHANGED)) {
+            continue;
+        }
+
+        // Flood the group of changed tiles i is in, 8-connected.
+        top = bottom = i / g->tile_cols;
+        left = right = i % g->tile_cols;
+        seen[i] = 1;
+        stack[depth++] = i;
+        while (depth > 0) {
+            tile = stack[--depth];
+            row = tile / g->tile_cols;
+            col = tile % g->tile_cols;
+            top = row < top ? row : top;
+            bottom = row > bottom ? row : bottom;
+            left = col < left ? col : left;
+            right = col > right ? col : right;
+
+            for (int r = row - 1; r <= row + 1; r++) {
+                for (int c = col - 1; c <= col + 1; c++) {
+                    if (r < 0 || r >= g->tile_rows || c < 0 ||
+                        c >= g->tile_cols) {
+                        continue;
+                    }
+                    tile = r * g->tile_cols + c;
+                    if (!seen[tile] && (g->tiles[tile] & TILE_CHANGED)) {
+                        seen[tile] = 1;
+                        stack[depth++] = tile;
+                    }
+                }
+            }
+        }
+
+        cells_to_canvas(top * TILE_SIZE, (bottom + 1) * TILE_SIZE,
+                        canvas->stride, canvas->rows, &y0, &y1);
+        cells_to_canvas(left * TILE_SIZE, (right + 1) * TILE_SIZE,
+                        canvas->stride, canvas->cols, &x0, &x1);
+        if (x0 < x1 && y0 < y1) {
+            rects[amount++] =
+                canvas_to_pixels(canvas, (ge_Rect){x0, y0, x1 - x0, y1 - y0});
+        }
+    }
 
-typedef struct {
-    int rows;
-    int cols;
-    Board board;
-    bool modified;
-} Grid;
+    return amount;
+}
 
-typedef struct {
-    char *code;
-    int next_state;
-} Rule;
+// The rectangle around the canvas cells that differ from the last frame,
+// in gif pixels. Returns false if none do.
+static bool changed_bbox(const GifCanvas *canvas, ge_Rect *rect) {
+    int top = canvas->rows;
+    int left = canvas->cols;
+    int bottom = -1;
+    int right = -1;
+    size_t k = 0;
+
+    for (int y = 0; y < canvas->rows; y++) {
+        for (int x = 0; x < canvas->cols; x++, k++) {
+            if (canvas->cells[k] != canvas->last[k]) {
+                top = y < top ? y : top;
+                bottom = y;
+                left = x < left ? x : left;
+                right = x > right ? x : right;
+            }
+        }
+    }
+    if (bottom < 0) {
+        return false;
+    }
 
-typedef struct {
-    int rule_amount;
-    int default_state;
-    Rule rules[RULES];
-} RuleSet;
+    *rect = canvas_to_pixels(
+        canvas, (ge_Rect){left, top, right - left + 1, bottom - top + 1});
+    return true;
+}
 
-typedef struct {
-    int state_amount;
-    RuleSet ruleset[STATES];
-} CA;
+#define GIF_BATCH 64 // frames an export compresses at once
+#define GIF_IMAGES (GIF_BATCH * GE_MAX_RECTS)
+#define GIF_BATCH_CELLS ((size_t)64 << 20) // flush before copying more
+#define GIF_DELAY 25 // hundredths of a second each generation shows
+#define GIF_CYCLE 3  // longest cycle, in frames, that ends an export
+#define GIF_CLEAR GE_CLEAR_DEFERRED // when full code tables start over
 
+// Frames of an export waiting for the pool to compress them. Each image
+// keeps a copy of the canvas cells under it, as the canvas is drawn over by
+// later frames, and is encoded from them scaled up by factor.
 typedef struct {
-    Color bg;
-    Color fg;
-} Colors;
-
-typedef enum {
-    TitleScreen,
-    Play,
-    Paused,
-    RenderingGif,
-} GameStates;
+    ge_Image images[GIF_IMAGES];
+    uint8_t *cells[GIF_IMAGES];
+    size_t capacity[GIF_IMAGES];
+    int cols[GIF_IMAGES];       // of the copied cells
+    ge_Rect within[GIF_IMAGES]; // pixels of the image within its cells
+    int factor;
+    int image_amount;
+    int frame_images[GIF_BATCH]; // images in each frame, in order
+    uint16_t frame_delay[GIF_BATCH];
+    int frame_amount;
+    size_t cell_amount;
+    ge_Dict dicts[MAX_THREADS]; // one per item of compress_task
+    pthread_mutex_t lock;       // guards next_image and failed
+    int next_image;
+    bool failed;
+} GifBatch;
+
+// Compresses the images of the batch left, one at a time.
+static void compress_task(void *ctx, const int item) {
+    GifBatch *batch = ctx;
+    int i = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&batch->lock);
+        i = batch->next_image++;
+        pthread_mutex_unlock(&batch->lock);
+        if (i >= batch->image_amount) {
+            return;
+        }
 
-void clear_board(Board b) {
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            b[i][j] = 0;
+        if (ge_compress_scaled(&batch->dicts[item], batch->cells[i],
+                               batch->cols[i], batch->factor,
+                               batch->within[i],
+                               &batch->images[i].data) != 0) {
+            pthread_mutex_lock(&batch->lock);
+            batch->failed = true;
+            pthread_mutex_unlock(&batch->lock);
         }
     }
 }
 
-void neighbors(const Grid *g, const int row, const int col, const int states,
-               char code[]) {
-    signed int x, y;
-    int deltas[8][2] = {
-        {-1, -1}, {-1, 0}, {-1, 1}, {0, 1}, {1, 1}, {1, 0}, {1, -1}, {0, -1},
-    };
-    int total[STATES] = {0};
+// Compresses the batch on the pool, then writes its frames in order.
+static bool flush_batch(GifBatch *batch, ge_GIF *gif) {
+    int k = 0;
 
-    for (int i = 0; i < 8; i++) {
-        x = row + deltas[i][0];
-        y = col + deltas[i][1];
+    batch->next_image = 0;
+    parallel_for(pool.thread_amount, compress_task, batch);
+    if (batch->failed) {
+        return false;
+    }
 
-        if (x == -1) {
-            x = g->rows - 1;
-        } else if (x == (int)g->rows) {
-            x = 0;
-        };
-        if (y == -1) {
-            y = g->cols - 1;
-        } else if (y == (int)g->cols) {
-            y = 0;
-        };
+    for (int i = 0; i < batch->frame_amount; i++) {
+        ge_add_images(gif, batch->frame_delay[i], &batch->images[k],
+                      batch->frame_images[i]);
+        k += batch->frame_images[i];
+    }
+    batch->image_amount = 0;
+    batch->frame_amount = 0;
+    batch->cell_amount = 0;
+    return true;
+}
 
-        total[g->board[x][y]]++;
+// Adds the images planned for a frame to the batch, with the whole cells
+// each one covers. After the first frame, cells the gif already shows are
+// left transparent. The frame before is done growing its delay, so a full
+// batch is written first.
+static bool queue_frame(GifBatch *batch, ge_GIF *gif, GifCanvas *canvas,
+                        const ge_Rect *images, const int amount) {
+    const bool first = gif->nframes == 0 && batch->frame_amount == 0;
+    const int f = canvas->factor;
+    int k, x0, y0, cols, rows;
+    uint8_t *cells = NULL;
+    uint8_t *shown = NULL;
+    const uint8_t *line = NULL;
+    size_t size = 0;
+    size_t raw_runs = 0;
+    size_t diff_runs = 0;
+    ge_Rect r;
+
+    if ((batch->frame_amount == GIF_BATCH ||
+         batch->cell_amount >= GIF_BATCH_CELLS) &&
+        !flush_batch(batch, gif)) {
+        return false;
     }
 
-    for (int i = 0; i < states; i++) {
-        code[i] = total[i] + '0';
+    for (int i = 0; i < amount; i++) {
+        r = images[i];
+        k = batch->image_amount + i;
+        x0 = r.x / f;
+        y0 = r.y / f;
+        cols = (r.x + r.w + f - 1) / f - x0;
+        rows = (r.y + r.h + f - 1) / f - y0;
+        size = (size_t)cols * rows;
+        if (size > batch->capacity[k]) {
+            cells = realloc(batch->cells[k], size);
+            if (cells == NULL) {
+                return false;
+            }
+            batch->cells[k] = cells;
+            batch->capacity[k] = size;
+        }
+        // Leave the unchanged cells out if that makes fewer runs, else the
+        // extra symbol only breaks up the runs of the cells themselves.
+        raw_runs = diff_runs = 0;
+        for (int y = 0; y < rows; y++) {
+            line = canvas->cells + (size_t)(y0 + y) * canvas->cols + x0;
+            shown = canvas->last + (size_t)(y0 + y) * canvas->cols + x0;
+            cells = batch->cells[k] + (size_t)y * cols;
+            for (int x = 0; x < cols; x++) {
+                cells[x] = line[x] == shown[x] ? gif->transparent : line[x];
+                shown[x] = line[x];
+                if (x > 0) {
+                    raw_runs += line[x] != line[x - 1];
+                    diff_runs += cells[x] != cells[x - 1];
+                }
+            }
+        }
+        if (first || gif->transparent < 0 || raw_runs <= diff_runs) {
+            for (int y = 0; y < rows; y++) {
+                memcpy(batch->cells[k] + (size_t)y * cols,
+                       canvas->cells + (size_t)(y0 + y) * canvas->cols + x0,
+                       cols);
+            }
+        }
+        batch->images[k].rect = r;
+        batch->cols[k] = cols;
+        batch->within[k] = (ge_Rect){r.x - x0 * f, r.y - y0 * f, r.w, r.h};
+        batch->cell_amount += size;
     }
-    code[states] = '\0';
+
+    batch->image_amount += amount;
+    batch->frame_images[batch->frame_amount] = amount;
+    batch->frame_delay[batch->frame_amount++] = GIF_DELAY;
+    return true;
 }
 
-void print_grid_state(const Grid *g) {
-    for (int i = 0; i < g->rows; i++) {
-        for (int j = 0; j < g->cols; j++) {
-            if (g->board[i][j] > 0) {
-                printf("%d ", g->board[i][j]);
-            } else {
-                printf("- ");
+// Shows the last frame of the batch for `frames` more generations. Once its
+// delay is as long as a gif allows, frames of a single unchanged pixel carry
+// the rest.
+static bool hold_frame(GifBatch *batch, ge_GIF *gif, GifCanvas *canvas,
+                       long frames) {
+    uint16_t *delay = NULL;
+    ge_Rect pixel;
+    long room = 0;
+
+    while (frames > 0) {
+        delay = &batch->frame_delay[batch->frame_amount - 1];
+        room = (0xFFFF - *delay) / GIF_DELAY;
+        if (room == 0) {
+            ge_plan_rects(NULL, 0, &pixel);
+            if (!queue_frame(batch, gif, canvas, &pixel, 1)) {
+                return false;
             }
+            frames--;
+            continue;
         }
-        printf("\n");
+        room = room < frames ? room : frames;
+        *delay += room * GIF_DELAY;
+        frames -= room;
     }
+    return true;
 }
 
-void next_gen(Grid *curr_grid, Grid *next_grid, const CA *ca) {
-    char code[STATES] = "";
-    Rule rule = {0};
-    RuleSet rset = {0};
-    bool found = false;
+// Bits of a gif palette with room for `colors`, at most 256.
+static int gif_depth(const int colors) {
+    int depth = 1;
 
-    next_grid->rows = curr_grid->rows;
-    next_grid->cols = curr_grid->cols;
+    while (depth < 8 && (1 << depth) < colors) {
+        depth++;
+    }
+    return depth;
+}
 
-    for (int i = 0; i < next_grid->rows; i++) {
-        for (int j = 0; j < next_grid->cols; j++) {
-            found = false;
-            neighbors(curr_grid, i, j, ca->state_amount, code);
-            rset = ca->ruleset[curr_grid->board[i][j]];
+// The fewest frames, up to GIF_CYCLE, after which frame i seems to repeat
+// an earlier one, or 0. hashes holds the hashes of the canvas in the last
+// frames by their number modulo GIF_CYCLE + 1. Hashes can collide, so a
+// match still needs its cells compared.
+static int frame_period(const uint64_t *hashes, const int i) {
+    for (int p = 1; p <= GIF_CYCLE && p <= i; p++) {
+        if (hashes[(i - p) % (GIF_CYCLE + 1)] ==
+            hashes[i % (GIF_CYCLE + 1)]) {
+            return p;
+        }
+    }
+    return 0;
+}
 
-            for (int k = 0; k < rset.rule_amount; k++) {
-                rule = rset.rules[k];
+// Prints how well the images of an export compressed, over all threads.
+static void print_gif_stats(const char filename[], const GifBatch *batch) {
+    ge_Stats total = {0};
 
-                if (strcmp(rule.code, code) == 0) {
-                    next_grid->board[i][j] = rule.next_state;
-                    found = true;
-                    break;
-                }
-            }
+    for (int i = 0; i < pool.thread_amount; i++) {
+        total.pixels += batch->dicts[i].stats.pixels;
+        total.bytes += batch->dicts[i].stats.bytes;
+        total.clears += batch->dicts[i].stats.clears;
+    }
+    printf("%s: %.4f bytes per pixel over %llu pixels, %llu code table "
+           "resets\n",
+           filename,
+           total.pixels ? (double)total.bytes / total.pixels : 0.0,
+           (unsigned long long)total.pixels,
+           (unsigned long long)total.clears);
+}
 
-            if (!found) {
-                next_grid->board[i][j] = rset.default_state;
-            }
-        }
+// How far an export got, for another thread to show. The export stops at
+// the next frame once cancel is set.
+typedef struct {
+    pthread_mutex_t lock; // guards everything below
+    int frames;           // drawn so far
+    uint64_t generations; // simulated so far
+    uint64_t bytes;       // of the gif so far
+    bool cancel;
+    bool done;
+} GifProgress;
+
+// Publishes the progress of an export, if anyone is watching, and tells
+// whether it was cancelled.
+static bool report_progress(GifProgress *progress, const int frames,
+                            const uint64_t simulated, const ge_GIF *gif) {
+    bool cancel = false;
+
+    if (progress == NULL) {
+        return false;
     }
 
-    *curr_grid = *next_grid;
+    pthread_mutex_lock(&progress->lock);
+    progress->frames = frames;
+    progress->generations = simulated;
+    progress->bytes = gif->written;
+    cancel = progress->cancel;
+    pthread_mutex_unlock(&progress->lock);
+    return cancel;
 }
 
-void encode_gif(const int generations, const char filename[], Grid *g, Grid *n,
-                const CA *ca) {
-    const int w = 800;
-    const int h = 800;
-    int factor = 0;
+static void free_batch(GifBatch *batch) {
+    for (int i = 0; i < GIF_IMAGES; i++) {
+        free(batch->cells[i]);
+        free(batch->images[i].data.data);
+    }
+    for (int i = 0; i < MAX_THREADS; i++) {
+        ge_dict_free(&batch->dicts[i]);
+    }
+    pthread_mutex_destroy(&batch->lock);
+    free(batch);
+}
 
-    uint8_t palette[COLORS * 3] = {0, 0, 0, 255, 255, 0, 100, 0, 0, 0, 255, 0};
+// Writes `generations` frames, each `step` generations after the last.
+// Frames are drawn a byte per cell and encoded from the cells, never at the
+// size of the gif. Single steps only redraw and encode the tiles that
+// changed. Frames are compressed in batches on the pool and written in
+// order.
+//
+// Frames that show no change lengthen the delay of the last one instead.
+// When the canvas holds the whole board, an export stops once the board is
+// still, holding the last frame for the rest, or once it repeats a cycle of
+// up to GIF_CYCLE frames. A frame whose hash matches an earlier one is kept,
+// and the export only stops if the cells a cycle later are the same, by
+// when it has shown the cycle twice.
+//
+// Progress goes to `progress` when it isn't NULL. A cancelled export keeps
+// the frames it had drawn, as does one whose step jump_gen can't make.
+void encode_gif(const int generations, const uint64_t step,
+                const char filename[], Grid *g, const CA *ca,
+                GifProgress *progress) {
+    // Boards are scaled up to GIF_SIZE pixels, those larger than a gif can
+    // hold are sampled every `stride` cells, the last block of a side
+    // shorter than the others.
+    const int longest = g->rows > g->cols ? g->rows : g->cols;
+    const int stride = (longest + GIF_MAX - 1) / GIF_MAX;
+    GifCanvas canvas = {
+        .cols = (g->cols + stride - 1) / stride,
+        .rows = (g->rows + stride - 1) / stride,
+        .stride = stride,
+        .factor = longest < GIF_SIZE ? GIF_SIZE / longest : 1,
+    };
+    const ge_Rect whole = {0, 0, canvas.cols, canvas.rows};
+    const ge_Rect pixels = canvas_to_pixels(&canvas, whole);
+    const size_t size = (size_t)canvas.cols * canvas.rows;
+    const int f = canvas.factor;
+    const int tiles = g->tile_rows * g->tile_cols;
+    // Unless it's sampled or a window on the plane, the canvas is the
+    // board, and equal hashes mean the board came back to an earlier state.
+    const bool whole_board = stride == 1 && g->boundary != Unbounded;
+    uint64_t hashes[GIF_CYCLE + 1] = {0};
+    uint8_t *cycle = NULL; // canvas of cycle_frame
+    int cycle_frame = 0;   // whose hash matched one cycle_period before
+    int cycle_period = 0;
+    ge_Rect planned[GE_MAX_RECTS];
+    uint64_t simulated = 0;
+    uint64_t jumped = 0;
+    int amount = 0;
+    int frames = 0;
+    int period = 0;
+    bool cancelled = false;
+    bool stuck = false;
+    bool ok = true;
+
+    // The palette holds the colors of the states and, after them, the index
+    // of transparent cells.
+    const int depth = gif_depth(ca->state_amount + 1);
+    uint8_t palette[256 * 3] = {0};
+
+    for (int s = 0; s < ca->state_amount; s++) {
+        palette[s * 3] = ca->colors[s] >> 16;
+        palette[s * 3 + 1] = ca->colors[s] >> 8;
+        palette[s * 3 + 2] = ca->colors[s];
+    }
 
-    ge_GIF *gif = ge_new_gif(
+    ge_Rect *rects = malloc(tiles * sizeof(ge_Rect));
+    uint8_t *seen = malloc(tiles);
+    int *stack = malloc(tiles * sizeof(int));
+    GifBatch *batch = calloc(1, sizeof(GifBatch));
+    ge_GIF *gif = ge_new_gif_images(
         filename,             /* file name */
-        w, h,                 /* canvas size */
-        palette, COLOR_DEPTH, /* palette depth == log2(# of colors) */
-        -1,                   /* no transparency */
+        pixels.w, pixels.h,   /* canvas size */
+        palette, depth,       /* palette depth == log2(# of colors) */
+        -1,                   /* no background transparency */
         0                     /* infinite loop */
     );
 
-    if (gif == NULL) {
+    if (gif != NULL) {
+        gif->transparent = ca->state_amount < 256 ? ca->state_amount : -1;
+    }
+    canvas.cells = calloc(size, 1);
+    canvas.last = calloc(size, 1);
+    if (batch != NULL) {
+        pthread_mutex_init(&batch->lock, NULL);
+        batch->factor = f;
+        for (int i = 0; i < pool.thread_amount && gif != NULL && ok; i++) {
+            ok = ge_dict_init(&batch->dicts[i], gif->depth) == 0;
+            batch->dicts[i].clear = GIF_CLEAR;
+        }
+    }
+    if (gif == NULL || rects == NULL || seen == NULL || stack == NULL ||
+        batch == NULL || canvas.cells == NULL ||
+        canvas.last == NULL || !ok) {
         perror("Error generating gif");
-        goto end;
+        free(rects);
+        free(seen);
+        free(stack);
+        free(canvas.cells);
+        free(canvas.last);
+        if (batch != NULL) {
+            free_batch(batch);
+        }
+        if (gif != NULL) {
+            ge_close_gif(gif);
+        }
+        return;
     }
 
-    for (int i = 0; i < generations; i++) {
-        factor = w / g->cols;
+    for (frames = 0; frames < generations && ok; frames++) {
+        if (report_progress(progress, frames, simulated, gif)) {
+            cancelled = true;
+            break;
+        }
+
+        if (frames == 0) {
+            draw_canvas(&canvas, g, whole);
+            rects[0] = pixels;
+            amount = 1;
+        } else if (step != 1) {
+            draw_canvas(&canvas, g, whole);
+            amount = changed_bbox(&canvas, rects) ? 1 : 0;
+        } else {
+            amount = changed_rects(g, &canvas, rects, seen, stack);
+            for (int k = 0; k < amount; k++) {
+                draw_canvas(&canvas, g,
+                            (ge_Rect){rects[k].x / f, rects[k].y / f,
+                                      rects[k].w / f, rects[k].h / f});
+            }
+        }
 
-        for (int row = 0; row < g->rows; row++) {
-            for (int col = 0; col < g->cols; col++) {
-                for (int l = row * factor; l < (row + 1) * factor; l++) {
-                    for (int m = col * factor; m < (col + 1) * factor; m++) {
-                        gif->frame[l * w + m] = g->board[row][col];
-                    }
-                }
+        hashes[frames % (GIF_CYCLE + 1)] = canvas.hash;
+        period = 0;
+        if (cycle_period > 0 && frames == cycle_frame + cycle_period) {
+            if (memcmp(cycle, canvas.cells, size) == 0) {
+                period = cycle_period;
+            }
+            cycle_period = 0;
+        }
+        if (whole_board && period == 0 && cycle_period == 0 &&
+            frame_period(hashes, frames) > 0) {
+            // Without memory for the copy, the export just runs on.
+            if (cycle == NULL) {
+                cycle = malloc(size);
+            }
+            if (cycle != NULL) {
+                memcpy(cycle, canvas.cells, size);
+                cycle_frame = frames;
+                cycle_period = frame_period(hashes, frames);
             }
         }
+        if (period > 1) {
+            break;
+        } else if (period == 1) {
+            ok = hold_frame(batch, gif, &canvas, generations - frames);
+            break;
+        } else if (amount == 0) {
+            ok = hold_frame(batch, gif, &canvas, 1);
+        } else {
+            amount = ge_plan_rects(rects, amount, planned);
+            ok = queue_frame(batch, gif, &canvas, planned, amount);
+        }
+
+        if (ok && frames < generations - 1) {
+            jumped = jump_gen(g, ca, step);
+            simulated += jumped;
+            if (jumped < step) {
+                frames++;
+                stuck = true;
+                break;
+            }
+        }
+    }
+    ok = ok && flush_batch(batch, gif);
+    report_progress(progress, frames, simulated, gif);
+    if (!ok) {
+        perror("Error compressing gif");
+    } else {
+        printf("%s: %d of %d frames in %d gif frames, %llu generations "
+               "simulated",
+               filename,
+               period > 1 || cancelled || stuck ? frames : generations,
+               generations, gif->nframes, (unsigned long long)simulated);
+        if (cancelled) {
+            printf(", cancelled");
+        } else if (stuck) {
+            printf(", stopped at a step too long to make without HashLife");
+        } else if (period > 1) {
+            printf(", stopped at a cycle of %d frames", period);
+        } else if (period == 1) {
+            printf(", stopped at a still board");
+        }
+        printf("\n");
+        print_gif_stats(filename, batch);
+    }
+
+    free(rects);
+    free(seen);
+    free(stack);
+    free(canvas.cells);
+    free(canvas.last);
+    free(cycle);
+    free_batch(batch);
+    if (ge_close_gif(gif) != 0) {
+        perror("Error writing gif");
+    }
+}
+
+#define GIF_JOBS 4 // exports that can run at once
+#define GIF_FRAMES 1000 // generations an export shows
+
+// An export running on its own thread, from copies of the grid and the CA
+// taken when it started, so that play goes on meanwhile.
+typedef struct {
+    pthread_t thread;
+    bool running; // started and not joined yet
+    Grid grid;
+    CA ca;
+    char filename[32];
+    double started; // GetTime() when it started
+    GifProgress progress;
+} GifJob;
+
+static void *export_worker(void *arg) {
+    GifJob *job = arg;
+
+    encode_gif(GIF_FRAMES, 1, job->filename, &job->grid, &job->ca,
+               &job->progress);
+
+    pthread_mutex_lock(&job->progress.lock);
+    job->progress.done = true;
+    pthread_mutex_unlock(&job->progress.lock);
+    return NULL;
+}
+
+// Starts exporting g to the next free file name, unless every job is busy.
+bool start_export(GifJob jobs[], const Grid *g, const CA *ca) {
+    static int exports = 0;
+    GifJob *job = NULL;
+
+    for (int i = 0; i < GIF_JOBS && job == NULL; i++) {
+        if (!jobs[i].running) {
+            job = &jobs[i];
+        }
+    }
+    if (job == NULL || !copy_grid(&job->grid, g)) {
+        return false;
+    }
+
+    job->ca = *ca;
+    snprintf(job->filename, sizeof(job->filename), "test%d.gif", ++exports);
+    job->started = GetTime();
+    job->progress = (GifProgress){0};
+    pthread_mutex_init(&job->progress.lock, NULL);
+    if (pthread_create(&job->thread, NULL, export_worker, job) != 0) {
+        perror("Error starting export");
+        pthread_mutex_destroy(&job->progress.lock);
+        free_grid(&job->grid);
+        return false;
+    }
+    job->running = true;
+    return true;
+}
+
+// Joins the exports that finished, or every export once they're told to
+// cancel.
+void reap_exports(GifJob jobs[], const bool cancel) {
+    bool done = false;
+
+    for (int i = 0; i < GIF_JOBS; i++) {
+        if (!jobs[i].running) {
+            continue;
+        }
+
+        pthread_mutex_lock(&jobs[i].progress.lock);
+        jobs[i].progress.cancel |= cancel;
+        done = jobs[i].progress.done || cancel;
+        pthread_mutex_unlock(&jobs[i].progress.lock);
+        if (done) {
+            pthread_join(jobs[i].thread, NULL);
+            pthread_mutex_destroy(&jobs[i].progress.lock);
+            free_grid(&jobs[i].grid);
+            jobs[i].running = false;
+        }
+    }
+}
 
-        next_gen(g, n, ca);
+// Cancels the last export started that is still running.
+void cancel_export(GifJob jobs[]) {
+    GifJob *job = NULL;
 
-        ge_add_frame(gif, 25);
+    for (int i = 0; i < GIF_JOBS; i++) {
+        if (jobs[i].running &&
+            (job == NULL || jobs[i].started > job->started)) {
+            job = &jobs[i];
+        }
+    }
+    if (job != NULL) {
+        pthread_mutex_lock(&job->progress.lock);
+        job->progress.cancel = true;
+        pthread_mutex_unlock(&job->progress.lock);
     }
-end:
-    ge_close_gif(gif);
 }
 
 void random_grid(int rows, int cols, int states, Grid *curr_grid) {
     srand(time(NULL));
 
-    curr_grid->rows = rows;
-    curr_grid->cols = cols;
+    if (!reshape_grid(curr_grid, rows, cols, curr_grid->packed)) {
+        perror("Error allocating board");
+        return;
+    }
+    clear_plane(&curr_grid->plane);
 
     for (int i = 0; i < rows; i++) {
         for (int j = 0; j < cols; j++) {
-            curr_grid->board[i][j] = rand() % states;
+            set_cell(curr_grid, i, j, rand() % states);
         }
     }
 }
@@ -206,9 +2764,48 @@ void init_ruleset(RuleSet *rset, int r_amount, int d_state, char *codes[],
     }
 }
 
+// Turns the string codes of every rule set into ca->table. Each code holds
+// one neighbor count digit per state; codes that do not add up to 8 can
+// never match and are ignored. Must be called after the rules are defined.
+void compile_rules(CA *ca) {
+    RuleSet *rset = NULL;
+    const char *code = NULL;
+    int index = 0;
+    int total = 0;
+    int s = 0;
+
+    for (s = 0; s < ca->state_amount; s++) {
+        ca->weight[s] = s == 0 ? 0 : (s == 1 ? 1 : ca->weight[s - 1] * 9);
+    }
+
+    for (int state = 0; state < ca->state_amount; state++) {
+        rset = &ca->ruleset[state];
+        memset(ca->table[state], rset->default_state, COMBOS);
+
+        // Walk backwards so the first matching rule wins, as before.
+        for (int k = rset->rule_amount - 1; k >= 0; k--) {
+            code = rset->rules[k].code;
+            index = total = 0;
+
+            for (s = 0; s < ca->state_amount && code[s] >= '0' &&
+                        code[s] <= '8';
+                 s++) {
+                index += (code[s] - '0') * ca->weight[s];
+                total += code[s] - '0';
+            }
+
+            if (s == ca->state_amount && code[s] == '\0' && total == 8) {
+                ca->table[state][index] = rset->rules[k].next_state;
+            }
+        }
+    }
+}
+
 // https://conwaylife.com/wiki/Conway%27s_Game_of_Life
 void GoL(CA *ca) {
     ca->state_amount = 2;
+    ca->colors[0] = 0x000000;
+    ca->colors[1] = 0xFFFF00;
 
     init_ruleset(&ca->ruleset[0], 1, 0, (char *[]){"53"}, (int[]){1});
 
@@ -218,6 +2815,8 @@ void GoL(CA *ca) {
 // https://conwaylife.com/wiki/OCA:Seeds
 void Seeds(CA *ca) {
     ca->state_amount = 2;
+    ca->colors[0] = 0x000000;
+    ca->colors[1] = 0xFFFFFF;
 
     init_ruleset(&ca->ruleset[0], 1, 0, (char *[]){"62"}, (int[]){1});
 }
@@ -225,6 +2824,8 @@ void Seeds(CA *ca) {
 // https://conwaylife.com/wiki/OCA:H-trees
 void HT(CA *ca) {
     ca->state_amount = 2;
+    ca->colors[0] = 0x000000;
+    ca->colors[1] = 0x00FF00;
 
     init_ruleset(&ca->ruleset[0], 1, 0, (char *[]){"71"}, (int[]){1});
 
@@ -234,6 +2835,8 @@ void HT(CA *ca) {
 // https://conwaylife.com/wiki/OCA:Serviettes
 void Serv(CA *ca) {
     ca->state_amount = 2;
+    ca->colors[0] = 0xFFFFFF;
+    ca->colors[1] = 0x0000C0;
 
     init_ruleset(&ca->ruleset[0], 3, 0, (char *[]){"62", "53", "44"},
                  (int[]){1, 1, 1});
@@ -242,6 +2845,9 @@ void Serv(CA *ca) {
 // https://conwaylife.com/wiki/OCA:Brian%27s_Brain
 void BB(CA *ca) {
     ca->state_amount = 3;
+    ca->colors[0] = 0x000000;
+    ca->colors[1] = 0xFFFFFF;
+    ca->colors[2] = 0x3050FF;
 
     init_ruleset(&ca->ruleset[0], 7, 0,
                  (char *[]){"620", "521", "422", "323", "224", "125", "026"},
@@ -250,37 +2856,464 @@ void BB(CA *ca) {
     ca->ruleset[1].default_state = 2;
 }
 
-void draw_grid(Grid curr_grid, Colors palette, int screen_width,
-               int screen_height, int *square_size, int *y_offset,
-               int *x_offset) {
-    int grid_h_boundary = 0;
-    int grid_v_boundary = 0;
+// Points the camera at the whole board, in 70% of the width of the window
+// and centered vertically. Cells are a whole number of pixels wide, unless
+// they have to be smaller than one.
+static void fit_camera(BoardView *view, const Grid *g, int screen_width,
+                       int screen_height) {
+    const int x_offset = screen_width * 0.02;
+    const float width = (int)(screen_width * 0.7) + x_offset;
+    const float height = screen_height;
+    float zoom = width / g->cols < height / g->rows ? width / g->cols
+                                                    : height / g->rows;
+
+    if (zoom >= 1) {
+        zoom = floorf(zoom);
+    }
+    view->camera = (Camera2D){
+        .offset = {x_offset, floorf(fmaxf(height - zoom * g->rows, 0) / 2)},
+        .target = {0, 0},
+        .rotation = 0,
+        .zoom = zoom,
+    };
+}
+
+// Zooms the camera with the mouse wheel, around the pointer, and pans it by
+// dragging with the middle button or with the arrow keys. Until then, or
+// after Home, it's fitted to the board every frame.
+void move_camera(BoardView *view, const Grid *g, int screen_width,
+                 int screen_height) {
+    const float wheel = GetMouseWheelMove();
+    const Vector2 mouse = GetMousePosition();
+    Vector2 pan = {0, 0};
+    Vector2 under = {0, 0};
+
+    if (IsKeyReleased(KEY_HOME)) {
+        view->moved = false;
+    }
+    if (!view->moved) {
+        fit_camera(view, g, screen_width, screen_height);
+    }
 
-    *x_offset = screen_width * 0.02;
-    grid_h_boundary = (screen_width * 0.7) + *x_offset;
-    grid_v_boundary = screen_height;
+    if (wheel != 0) {
+        // Keep the point under the pointer where it is.
+        under = GetScreenToWorld2D(mouse, view->camera);
+        view->camera.zoom = fminf(
+            fmaxf(view->camera.zoom * powf(ZOOM_STEP, wheel), MIN_ZOOM),
+            MAX_ZOOM);
+        view->camera.offset = mouse;
+        view->camera.target = under;
+        view->moved = true;
+    }
 
-    if (grid_v_boundary / curr_grid.rows < grid_h_boundary / curr_grid.cols) {
-        *square_size = grid_v_boundary / curr_grid.rows;
-    } else {
-        *square_size = grid_h_boundary / curr_grid.cols;
+    if (IsMouseButtonDown(MOUSE_BUTTON_MIDDLE)) {
+        pan = GetMouseDelta();
+    }
+    pan.x += (IsKeyDown(KEY_LEFT) - IsKeyDown(KEY_RIGHT)) * PAN_SPEED;
+    pan.y += (IsKeyDown(KEY_UP) - IsKeyDown(KEY_DOWN)) * PAN_SPEED;
+    if (pan.x != 0 || pan.y != 0) {
+        view->camera.target.x -= pan.x / view->camera.zoom;
+        view->camera.target.y -= pan.y / view->camera.zoom;
+        view->moved = true;
+    }
+}
+
+// The cell under a point of the window. Returns false if it's off the
+// board.
+bool screen_to_cell(const BoardView *view, const Grid *g, const Vector2 point,
+                    int *row, int *col) {
+    const Vector2 cell = GetScreenToWorld2D(point, view->camera);
+
+    if (cell.y < 0 || cell.x < 0 || cell.y >= g->rows || cell.x >= g->cols) {
+        return false;
+    }
+    *row = (int)cell.y;
+    *col = (int)cell.x;
+    return true;
+}
+
+// The cells of g that the camera shows in the window, rows top to bottom - 1
+// and columns left to right - 1. Empty when it shows none.
+static void visible_cells(const Grid *g, const Camera2D camera,
+                          int screen_width, int screen_height, int *top,
+                          int *left, int *bottom, int *right) {
+    const Vector2 a = GetScreenToWorld2D((Vector2){0, 0}, camera);
+    const Vector2 b =
+        GetScreenToWorld2D((Vector2){screen_width, screen_height}, camera);
+
+    *top = (int)fminf(fmaxf(floorf(a.y), 0), g->rows);
+    *left = (int)fminf(fmaxf(floorf(a.x), 0), g->cols);
+    *bottom = (int)fminf(fmaxf(ceilf(b.y), 0), g->rows);
+    *right = (int)fminf(fmaxf(ceilf(b.x), 0), g->cols);
+}
+
+void draw_grid(const Grid *curr_grid, Colors palette, const Camera2D camera,
+               int screen_width, int screen_height) {
+    const Vector2 origin = GetWorldToScreen2D((Vector2){0, 0}, camera);
+    int top, left, bottom, right, x, y, w, h;
+
+    visible_cells(curr_grid, camera, screen_width, screen_height, &top, &left,
+                  &bottom, &right);
+    for (int i = top; i < bottom; i++) {
+        y = floorf(origin.y + i * camera.zoom);
+        h = floorf(origin.y + (i + 1) * camera.zoom) - y;
+        for (int j = left; j < right; j++) {
+            x = floorf(origin.x + j * camera.zoom);
+            w = floorf(origin.x + (j + 1) * camera.zoom) - x;
+            if (get_cell(curr_grid, i, j) == 1) {
+                DrawRectangle(x, y, w > 1 ? w : 1, h > 1 ? h : 1, palette.fg);
+            }
+        }
+    }
+}
+
+// Writes the colors of the cells from (top, left) on, rows by cols of them,
+// into pixels a row after the other.
+static void cells_to_colors(const Grid *g, const Color colors[STATES],
+                            const int top, const int left, const int rows,
+                            const int cols, Color *pixels) {
+    const uint64_t *bits = NULL;
+    const uint8_t *row = NULL;
+    Color *out = NULL;
+
+    for (int i = 0; i < rows; i++) {
+        out = pixels + (size_t)i * cols;
+        if (g->packed) {
+            bits = grid_bits(g, top + i);
+            for (int j = left; j < left + cols; j++) {
+                *out++ = colors[(bits[j / 64] >> (j % 64)) & 1];
+            }
+        } else {
+            row = grid_row(g, top + i) + left;
+            for (int j = 0; j < cols; j++) {
+                out[j] = colors[row[j]];
+            }
+        }
+    }
+}
+
+// Uploads the cells from (top, left) on, rows by cols of them, that are
+// under the texture.
+static void upload_cells(const Grid *g, BoardView *view,
+                         const Color colors[STATES], const int top,
+                         const int left, const int rows, const int cols) {
+    const int y0 = top > view->top ? top : view->top;
+    const int x0 = left > view->left ? left : view->left;
+    const int y1 = top + rows < view->top + view->rows ? top + rows
+                                                       : view->top + view->rows;
+    const int x1 = left + cols < view->left + view->cols
+                       ? left + cols
+                       : view->left + view->cols;
+
+    if (y1 <= y0 || x1 <= x0) {
+        return;
+    }
+
+    cells_to_colors(g, colors, y0, x0, y1 - y0, x1 - x0, view->pixels);
+    UpdateTextureRec(view->texture,
+                     (Rectangle){x0 - view->left, y0 - view->top, x1 - x0,
+                                 y1 - y0},
+                     view->pixels);
+    view->uploaded += (size_t)(y1 - y0) * (x1 - x0) * sizeof(Color);
+}
+
+// Clears TILE_UNSEEN on the tiles under the texture.
+static void clear_unseen(Grid *g, const BoardView *view) {
+    const int tile_bottom = (view->top + view->rows - 1) / TILE_SIZE;
+    const int tile_right = (view->left + view->cols - 1) / TILE_SIZE;
+
+    for (int tr = view->top / TILE_SIZE; tr <= tile_bottom; tr++) {
+        for (int tc = view->left / TILE_SIZE; tc <= tile_right; tc++) {
+            g->tiles[tr * g->tile_cols + tc] &= ~TILE_UNSEEN;
+        }
+    }
+}
+
+// Uploads the tiles under the texture that changed since it was drawn. A
+// run of them along a row of tiles goes up as one rectangle, which grows
+// down for as long as the rows below have a run over the same tiles. Once
+// most tiles changed, the whole texture goes up instead.
+static void upload_tiles(Grid *g, BoardView *view,
+                         const Color colors[STATES]) {
+    const int tile_top = view->top / TILE_SIZE;
+    const int tile_left = view->left / TILE_SIZE;
+    const int tile_bottom = (view->top + view->rows - 1) / TILE_SIZE + 1;
+    const int tile_right = (view->left + view->cols - 1) / TILE_SIZE + 1;
+    TileSpan *above = view->spans;
+    TileSpan *spans = view->spans + (tile_right - tile_left);
+    TileSpan *swap = NULL;
+    const uint8_t *flags = NULL;
+    int above_amount = 0;
+    int amount = 0;
+    int unseen = 0;
+    int end = 0;
+    int k = 0;
+
+    for (int tr = tile_top; tr < tile_bottom; tr++) {
+        flags = &g->tiles[tr * g->tile_cols];
+        for (int tc = tile_left; tc < tile_right; tc++) {
+            unseen += (flags[tc] & TILE_UNSEEN) != 0;
+        }
+    }
+    if (unseen * 2 > (tile_bottom - tile_top) * (tile_right - tile_left)) {
+        clear_unseen(g, view);
+        cells_to_colors(g, colors, view->top, view->left, view->rows,
+                        view->cols, view->pixels);
+        UpdateTexture(view->texture, view->pixels);
+        view->uploaded = (size_t)view->rows * view->cols * sizeof(Color);
+        return;
     }
 
-    *y_offset = (screen_height - (*square_size * curr_grid.rows)) / 2;
+    // A row past the last one ends the spans still open.
+    for (int tr = tile_top; tr <= tile_bottom && unseen > 0; tr++) {
+        flags = tr < tile_bottom ? &g->tiles[tr * g->tile_cols] : NULL;
+        amount = 0;
+        k = 0;
+        for (int tc = tile_left; flags != NULL && tc < tile_right;
+             tc = end + 1) {
+            end = tc;
+            while (end < tile_right && (flags[end] & TILE_UNSEEN)) {
+                end++;
+            }
+            if (end == tc) {
+                continue;
+            }
 
-    for (int i = 0; i < curr_grid.rows; i++) {
-        for (int j = 0; j < curr_grid.cols; j++) {
-            if (curr_grid.board[i][j] == 1) {
-                DrawRectangle((j * *square_size) + *x_offset,
-                              (i * *square_size) + *y_offset, *square_size,
-                              *square_size, palette.fg);
+            // Spans above that end before this run are done, one over the
+            // same tiles goes on.
+            for (; k < above_amount && above[k].right <= tc; k++) {
+                upload_cells(g, view, colors, above[k].top * TILE_SIZE,
+                             above[k].left * TILE_SIZE,
+                             (tr - above[k].top) * TILE_SIZE,
+                             (above[k].right - above[k].left) * TILE_SIZE);
+            }
+            if (k < above_amount && above[k].left == tc &&
+                above[k].right == end) {
+                spans[amount++] = above[k++];
             } else {
-                DrawRectangleLines((j * *square_size) + *x_offset,
-                                   (i * *square_size) + *y_offset, *square_size,
-                                   *square_size, palette.fg);
+                spans[amount++] = (TileSpan){tc, end, tr};
             }
         }
+        for (; k < above_amount; k++) {
+            upload_cells(g, view, colors, above[k].top * TILE_SIZE,
+                         above[k].left * TILE_SIZE,
+                         (tr - above[k].top) * TILE_SIZE,
+                         (above[k].right - above[k].left) * TILE_SIZE);
+        }
+
+        swap = above;
+        above = spans;
+        spans = swap;
+        above_amount = amount;
+    }
+    clear_unseen(g, view);
+}
+
+// Writes the colors of the squares of a pyramid level from (top, left) on,
+// rows by cols of them, into pixels a row after the other.
+static void squares_to_colors(const Pyramid *p, const int level,
+                              const Color shades[256], const int top,
+                              const int left, const int rows, const int cols,
+                              Color *pixels) {
+    const int stride = level_size(p->cols, level);
+    const uint8_t *row = NULL;
+
+    for (int i = 0; i < rows; i++) {
+        row = &p->levels[level][(size_t)(top + i) * stride + left];
+        for (int j = 0; j < cols; j++) {
+            pixels[(size_t)i * cols + j] = shades[row[j]];
+        }
+    }
+}
+
+// Draws the cells the camera shows like draw_grid, but with one texture
+// upload of the tiles that changed and one draw call, whatever the number
+// of cells. Live states get darker shades of the foreground color.
+//
+// Once cells are smaller than a pixel, the texture holds the squares of the
+// pyramid level with about one per pixel instead, the density of each one
+// blending the background into the foreground color.
+void draw_grid_texture(Grid *g, BoardView *view, Colors palette,
+                       int screen_width, int screen_height) {
+    Color colors[STATES] = {palette.bg};
+    Color shades[256];
+    Color *pixels = NULL;
+    TileSpan *spans = NULL;
+    int top, left, bottom, right, rows, cols;
+    int level = 0;
+    bool reload = false;
+    bool whole = false;
+
+    visible_cells(g, view->camera, screen_width, screen_height, &top, &left,
+                  &bottom, &right);
+    if (bottom <= top || right <= left) {
+        return;
+    }
+
+    while (ldexpf(view->camera.zoom, level) < 1 &&
+           (level_size(g->rows, level) > 1 || level_size(g->cols, level) > 1)) {
+        level++;
+    }
+    if (level > 0 && !update_pyramid(&view->pyramid, g)) {
+        TraceLog(LOG_WARNING, "No memory for the levels of a %dx%d board",
+                 g->cols, g->rows);
+        return;
+    }
+    top >>= level;
+    left >>= level;
+    rows = level_size(bottom, level) - top;
+    cols = level_size(right, level) - left;
+
+    for (int s = 1; s < STATES; s++) {
+        colors[s] = ColorBrightness(palette.fg, -0.3f * (s - 1));
+    }
+    for (int d = 0; d < 256; d++) {
+        shades[d] = (Color){
+            palette.bg.r + (palette.fg.r - palette.bg.r) * d / 255,
+            palette.bg.g + (palette.fg.g - palette.bg.g) * d / 255,
+            palette.bg.b + (palette.fg.b - palette.bg.b) * d / 255,
+            palette.bg.a + (palette.fg.a - palette.bg.a) * d / 255,
+        };
+    }
+
+    reload = rows != view->rows || cols != view->cols || level != view->level;
+    if (reload) {
+        pixels = realloc(view->pixels, (size_t)rows * cols * sizeof(Color));
+        if (pixels != NULL) {
+            view->pixels = pixels;
+            spans = realloc(view->spans, 2 * (cols / TILE_SIZE + 2) *
+                                             sizeof(TileSpan));
+        }
+        if (pixels == NULL || spans == NULL) {
+            TraceLog(LOG_WARNING, "No memory for a %dx%d board texture",
+                     cols, rows);
+            return;
+        }
+        view->spans = spans;
+        if (view->rows > 0) {
+            UnloadTexture(view->texture);
+        }
+    }
+
+    // New textures, and those panning moved over the board, are filled
+    // whole, as are levels of the pyramid that changed.
+    whole = reload || top != view->top || left != view->left ||
+            (level > 0 && view->pyramid.summed_amount > 0);
+    view->top = top;
+    view->left = left;
+    view->rows = rows;
+    view->cols = cols;
+    view->level = level;
+    view->uploaded = 0;
+    if (whole) {
+        if (level == 0) {
+            cells_to_colors(g, colors, top, left, rows, cols, view->pixels);
+            clear_unseen(g, view);
+        } else {
+            squares_to_colors(&view->pyramid, level, shades, top, left, rows,
+                              cols, view->pixels);
+        }
+        if (reload) {
+            view->texture = LoadTextureFromImage(
+                (Image){view->pixels, cols, rows, 1,
+                        PIXELFORMAT_UNCOMPRESSED_R8G8B8A8});
+            SetTextureFilter(view->texture, TEXTURE_FILTER_POINT);
+        } else {
+            UpdateTexture(view->texture, view->pixels);
+        }
+        view->uploaded = (size_t)rows * cols * sizeof(Color);
+    } else if (level == 0) {
+        upload_tiles(g, view, colors);
+    }
+
+    BeginMode2D(view->camera);
+    DrawTexturePro(view->texture, (Rectangle){0, 0, cols, rows},
+                   (Rectangle){ldexpf(left, level), ldexpf(top, level),
+                               ldexpf(cols, level), ldexpf(rows, level)},
+                   (Vector2){0, 0}, 0.0f, WHITE);
+    EndMode2D();
+}
+
+// Draws the outlines of the cells the camera shows into view->lines, a
+// line between each two. They only move with the camera, the window or the
+// board, so they are drawn again only when one of them changed.
+static void draw_lines(const Grid *g, BoardView *view, Colors palette,
+                       int screen_width, int screen_height) {
+    const Camera2D camera = view->camera;
+    const Camera2D last = view->lines_camera;
+    const Vector2 origin = GetWorldToScreen2D((Vector2){0, 0}, camera);
+    int top, left, bottom, right, x0, y0, x1, y1, x, y;
+
+    if (view->lines.id > 0 && view->lines.texture.width == screen_width &&
+        view->lines.texture.height == screen_height &&
+        view->lines_rows == g->rows && view->lines_cols == g->cols &&
+        camera.offset.x == last.offset.x && camera.offset.y == last.offset.y &&
+        camera.target.x == last.target.x && camera.target.y == last.target.y &&
+        camera.zoom == last.zoom) {
+        return;
+    }
+    if (view->lines.texture.width != screen_width ||
+        view->lines.texture.height != screen_height) {
+        if (view->lines.id > 0) {
+            UnloadRenderTexture(view->lines);
+        }
+        view->lines = LoadRenderTexture(screen_width, screen_height);
+    }
+    view->lines_camera = camera;
+    view->lines_rows = g->rows;
+    view->lines_cols = g->cols;
+
+    visible_cells(g, camera, screen_width, screen_height, &top, &left,
+                  &bottom, &right);
+    x0 = floorf(origin.x + left * camera.zoom);
+    y0 = floorf(origin.y + top * camera.zoom);
+    x1 = floorf(origin.x + right * camera.zoom);
+    y1 = floorf(origin.y + bottom * camera.zoom);
+
+    BeginTextureMode(view->lines);
+    ClearBackground(BLANK);
+    // The last line of the board is drawn inside its last cells.
+    for (int i = top; i <= bottom && right > left; i++) {
+        y = floorf(origin.y + i * camera.zoom) - (i == g->rows);
+        DrawRectangle(x0, y, x1 - x0, 1, palette.fg);
+    }
+    for (int j = left; j <= right && bottom > top; j++) {
+        x = floorf(origin.x + j * camera.zoom) - (j == g->cols);
+        DrawRectangle(x, y0, 1, y1 - y0, palette.fg);
+    }
+    EndTextureMode();
+}
+
+void draw_board(Grid *g, BoardView *view, Colors palette, int screen_width,
+                int screen_height) {
+    if (view->rects) {
+        draw_grid(g, palette, view->camera, screen_width, screen_height);
+        view->level = 0;
+    } else {
+        draw_grid_texture(g, view, palette, screen_width, screen_height);
+    }
+
+    // Outlines would only blur smaller cells together.
+    if (view->camera.zoom >= MIN_OUTLINED) {
+        draw_lines(g, view, palette, screen_width, screen_height);
+        // Render textures are upside down.
+        DrawTextureRec(view->lines.texture,
+                       (Rectangle){0, 0, screen_width, -screen_height},
+                       (Vector2){0, 0}, WHITE);
+    }
+}
+
+void free_view(BoardView *view) {
+    if (view->rows > 0) {
+        UnloadTexture(view->texture);
+    }
+    if (view->lines.id > 0) {
+        UnloadRenderTexture(view->lines);
     }
+    free(view->pixels);
+    free(view->spans);
+    free_pyramid(&view->pyramid);
+    *view = (BoardView){0};
 }
 
 void DrawTextCentered(char *text, int font_size, int y_offset, Color color,
@@ -289,8 +3322,61 @@ void DrawTextCentered(char *text, int font_size, int y_offset, Color color,
              sheight / 2 - y_offset, font_size, color);
 }
 
+// Statistics shown to the right of the board.
+void draw_stats(const Grid *g, const BoardView *view, Colors palette,
+                int screen_width) {
+    if (g->boundary == Unbounded) {
+        DrawText(TextFormat("Chunks: %d", (int)g->plane.chunk_amount),
+                 screen_width * 0.75, 20, 20, palette.fg);
+    } else {
+        DrawText(TextFormat("Active tiles: %d/%d", g->active_amount,
+                            g->tile_rows * g->tile_cols),
+                 screen_width * 0.75, 20, 20, palette.fg);
+    }
+
+    if (!view->rects) {
+        DrawText(TextFormat("Uploaded: %.1f KB", view->uploaded / 1024.0),
+                 screen_width * 0.75, 45, 20, palette.fg);
+    }
+}
+
+// Progress of the exports running, under the statistics.
+void draw_exports(GifJob jobs[], Colors palette, int screen_width) {
+    const int x = screen_width * 0.75;
+    const int width = screen_width * 0.2;
+    int y = 80;
+    int frames = 0;
+    uint64_t generations = 0;
+    uint64_t bytes = 0;
+    double seconds = 0.0;
+
+    for (int i = 0; i < GIF_JOBS; i++) {
+        if (!jobs[i].running) {
+            continue;
+        }
+
+        pthread_mutex_lock(&jobs[i].progress.lock);
+        frames = jobs[i].progress.frames;
+        generations = jobs[i].progress.generations;
+        bytes = jobs[i].progress.bytes;
+        pthread_mutex_unlock(&jobs[i].progress.lock);
+        seconds = GetTime() - jobs[i].started;
+
+        DrawText(TextFormat("%s: %.0f gen/s, %.1f MB", jobs[i].filename,
+                            seconds > 0 ? generations / seconds : 0.0,
+                            bytes / 1e6),
+                 x, y, 20, palette.fg);
+        DrawRectangleLines(x, y + 25, width, 10, palette.fg);
+        DrawRectangle(x, y + 25, width * frames / GIF_FRAMES, 10, palette.fg);
+        y += 50;
+    }
+}
+
 void check_keyboard_input(GameStates *state, Grid *curr_grid,
-                          Grid *initial_grid, const CA ca) {
+                          Grid *initial_grid, const CA ca, GifJob jobs[],
+                          BoardView *view) {
+    uint64_t jumped = 0;
+
     if (*state == TitleScreen) {
         if (IsKeyReleased(KEY_ENTER)) {
             *state = Paused;
@@ -302,7 +3388,7 @@ void check_keyboard_input(GameStates *state, Grid *curr_grid,
     } else if (*state == Paused) {
         if (IsKeyReleased(KEY_P)) {
             if (curr_grid->modified) {
-                *initial_grid = *curr_grid;
+                copy_grid(initial_grid, curr_grid);
                 curr_grid->modified = false;
             }
             *state = Play;
@@ -311,47 +3397,90 @@ void check_keyboard_input(GameStates *state, Grid *curr_grid,
 
     if (*state == Play || *state == Paused) {
         if (IsKeyReleased(KEY_G)) {
-            *state = RenderingGif;
+            if (!start_export(jobs, initial_grid, &ca)) {
+                TraceLog(LOG_WARNING, "No room for another export");
+            }
+        } else if (IsKeyReleased(KEY_X)) {
+            cancel_export(jobs);
+        } else if (IsKeyReleased(KEY_V)) {
+            view->rects = !view->rects;
+        } else if (IsKeyReleased(KEY_J)) {
+            // Bounded boards, and rules HashLife can't run, don't jump.
+            jumped = jump_gen(curr_grid, &ca, JUMP);
+            if (jumped < JUMP) {
+                TraceLog(LOG_WARNING, "Jumped %llu of %d generations, the "
+                                      "rest needs HashLife",
+                         (unsigned long long)jumped, JUMP);
+            }
+        } else if (IsKeyReleased(KEY_B)) {
+            Boundary boundary = curr_grid->boundary == Torus  ? Dead
+                                : curr_grid->boundary == Dead ? Unbounded
+                                                              : Torus;
+            // Rules that can't run on a plane go back to the torus.
+            if (!set_boundary(curr_grid, &ca, boundary)) {
+                boundary = Torus;
+                set_boundary(curr_grid, &ca, boundary);
+            }
+            set_boundary(initial_grid, &ca, boundary);
         } else if (IsKeyReleased(KEY_T)) {
             *state = TitleScreen;
         } else if (IsKeyReleased(KEY_C)) {
-            clear_board(curr_grid->board);
-            *initial_grid = *curr_grid;
+            clear_board(curr_grid);
+            copy_grid(initial_grid, curr_grid);
         } else if (IsKeyReleased(KEY_R)) {
-            *curr_grid = *initial_grid;
+            copy_grid(curr_grid, initial_grid);
         } else if (IsKeyReleased(KEY_N)) {
             random_grid(curr_grid->rows, curr_grid->cols, ca.state_amount,
                         curr_grid);
-            *initial_grid = *curr_grid;
+            copy_grid(initial_grid, curr_grid);
         }
     }
 }
 
-int main(void) {
+// Usage: automata [rows cols [threads]]
+int main(int argc, char *argv[]) {
     Grid curr_grid = {0};
-    Grid next_grid = {0};
     Grid initial_grid = {0};
     CA ca = {0};
+    int rows = 15;
+    int cols = 20;
+    int threads = 0;
+
+    if (argc >= 3) {
+        rows = atoi(argv[1]);
+        cols = atoi(argv[2]);
+    }
+    if (argc >= 4) {
+        threads = atoi(argv[3]);
+    }
+    if (rows < 1 || cols < 1 || argc == 2 || argc > 4) {
+        fprintf(stderr, "Usage: %s [rows cols [threads]]\n", argv[0]);
+        return 1;
+    }
+
+    start_pool(threads);
 
     GoL(&ca);
+    compile_rules(&ca);
 
-    curr_grid.cols = 20;
-    curr_grid.rows = 15;
-    initial_grid = curr_grid;
+    curr_grid.period2 = true;
+    if (!init_grid(&curr_grid, rows, cols, ca.state_amount == 2) ||
+        !copy_grid(&initial_grid, &curr_grid)) {
+        perror("Error allocating board");
+        return 1;
+    }
 
     SetConfigFlags(FLAG_WINDOW_RESIZABLE);
     InitWindow(WIDTH, HEIGHT, "Automata");
     const Colors palette = {BLACK, BLUE};
     int screen_width = GetScreenWidth();
     int screen_height = GetScreenHeight();
-    int square_size = 0;
-    int grid_y_offset = 0;
-    int grid_x_offset = 0;
     int mouse_row = 0;
     int mouse_col = 0;
     float delta_time = 0.0f;
-    float time_when_pressed = 0.0f;
     float grid_refresh = 0.5f;
+    GifJob jobs[GIF_JOBS] = {0};
+    BoardView view = {0};
 
     GameStates state;
     state = TitleScreen;
@@ -362,6 +3491,7 @@ int main(void) {
         screen_width = GetScreenWidth();
         screen_height = GetScreenHeight();
         delta_time += GetFrameTime();
+        reap_exports(jobs, false);
 
         BeginDrawing();
         ClearBackground(palette.bg);
@@ -374,63 +3504,64 @@ int main(void) {
             DrawTextCentered("Press Enter to begin.", 25, -40, palette.fg,
                              screen_width, screen_height);
 
-            check_keyboard_input(&state, &curr_grid, &initial_grid, ca);
+            check_keyboard_input(&state, &curr_grid, &initial_grid, ca, jobs,
+                                 &view);
 
             break;
         case Paused:
-            draw_grid(curr_grid, palette, screen_width, screen_height,
-                      &square_size, &grid_y_offset, &grid_x_offset);
-
-            // TODO: Maybe use CheckCollision*Rec funtions here
-            if (IsMouseButtonReleased(MOUSE_BUTTON_LEFT) ||
-                IsMouseButtonReleased(MOUSE_BUTTON_RIGHT)) {
-                TraceLog(LOG_DEBUG, "%d, %d",
-                         (GetMouseX() - grid_x_offset) / square_size,
-                         (GetMouseY() - grid_y_offset) / square_size);
-
+            move_camera(&view, &curr_grid, screen_width, screen_height);
+            draw_board(&curr_grid, &view, palette, screen_width,
+                       screen_height);
+            draw_stats(&curr_grid, &view, palette, screen_width);
+            draw_exports(jobs, palette, screen_width);
+
+            if ((IsMouseButtonReleased(MOUSE_BUTTON_LEFT) ||
+                 IsMouseButtonReleased(MOUSE_BUTTON_RIGHT)) &&
+                screen_to_cell(&view, &curr_grid, GetMousePosition(),
+                               &mouse_row, &mouse_col)) {
+                TraceLog(LOG_DEBUG, "%d, %d", mouse_col, mouse_row);
                 curr_grid.modified = true;
 
-                mouse_col = (GetMouseX() - grid_x_offset) / square_size;
-                mouse_row = (GetMouseY() - grid_y_offset) / square_size;
-
                 if (IsMouseButtonReleased(MOUSE_BUTTON_LEFT)) {
-                    curr_grid.board[mouse_row][mouse_col] = 1;
+                    set_cell(&curr_grid, mouse_row, mouse_col, 1);
                 } else {
-                    curr_grid.board[mouse_row][mouse_col] = 0;
+                    set_cell(&curr_grid, mouse_row, mouse_col, 0);
                 }
             }
 
-            check_keyboard_input(&state, &curr_grid, &initial_grid, ca);
+            check_keyboard_input(&state, &curr_grid, &initial_grid, ca, jobs,
+                                 &view);
 
             break;
         case Play:
-            draw_grid(curr_grid, palette, screen_width, screen_height,
-                      &square_size, &grid_y_offset, &grid_x_offset);
+            move_camera(&view, &curr_grid, screen_width, screen_height);
+            draw_board(&curr_grid, &view, palette, screen_width,
+                       screen_height);
+            draw_stats(&curr_grid, &view, palette, screen_width);
+            draw_exports(jobs, palette, screen_width);
 
             if (delta_time > grid_refresh) {
                 delta_time = 0.0f;
-                next_gen(&curr_grid, &next_grid, &ca);
+                next_gen(&curr_grid, &ca);
             }
 
-            check_keyboard_input(&state, &curr_grid, &initial_grid, ca);
-
-            break;
-        case RenderingGif:
-            DrawTextCentered("Rendering gif...", 30, 10, palette.fg,
-                             screen_width, screen_height);
-
-            if (GetTime() > time_when_pressed + 5) {
-                encode_gif(1000, "test.gif", &initial_grid, &next_grid, &ca);
-                state = Paused;
-            }
+            check_keyboard_input(&state, &curr_grid, &initial_grid, ca, jobs,
+                                 &view);
 
             break;
         }
         EndDrawing();
     }
 
+    free_view(&view);
     CloseWindow();
 
+    reap_exports(jobs, true);
+    stop_pool();
+    free_hashlife(&hashlife);
+    free_grid(&curr_grid);
+    free_grid(&initial_grid);
+
     return 0;
 }
 // LICENSE
@@ -13,7 +13,7 @@
 #endif
 
 /* helper to write a little-endian 16-bit number portably */
-#define write_num(fd, n) write((fd), (uint8_t[]){(n)&0xFF, (n) >> 8}, 2)
+#define put_num(gif, n) put_bytes((gif), (uint8_t[]){(n)&0xFF, (n) >> 8}, 2)
 
 static uint8_t vga[0x30] = {
     0x00, 0x00, 0x00, 0xAA, 0x00, 0x00, 0x00, 0xAA, 0x00, 0xAA, 0x55, 0x00,
@@ -22,39 +22,110 @@ static uint8_t vga[0x30] = {
     0x55, 0x55, 0xFF, 0xFF, 0x55, 0xFF, 0x55, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
 };
 
-struct Node {
-    uint16_t key;
-    struct Node *children[];
-};
-typedef struct Node Node;
+int ge_dict_init(ge_Dict *dict, int depth) {
+    dict->depth = depth > 1 ? depth : 2;
+    dict->degree = 1 << dict->depth;
+    dict->next = malloc(0x1000 * dict->degree * sizeof(uint16_t));
+    dict->runs = NULL;
+    dict->blocks = (ge_Memory){NULL, 0, 0};
+    dict->clear = GE_CLEAR_FULL;
+    dict->stats = (ge_Stats){0, 0, 0};
+    return dict->next ? 0 : -1;
+}
+
+void ge_dict_free(ge_Dict *dict) {
+    free(dict->next);
+    free(dict->runs);
+    free(dict->blocks.data);
+    dict->next = NULL;
+    dict->runs = NULL;
+    dict->blocks = (ge_Memory){NULL, 0, 0};
+}
+
+/* Start a code table with the single pixels only. */
+static void dict_reset(ge_Dict *dict) {
+    memset(dict->next, 0, dict->degree * dict->degree * sizeof(uint16_t));
+}
+
+/* Make code the one that extends prefix with pixel. */
+static void dict_add(ge_Dict *dict, int prefix, uint8_t pixel, int code) {
+    dict->next[prefix * dict->degree + pixel] = code;
+    memset(&dict->next[code * dict->degree], 0,
+           dict->degree * sizeof(uint16_t));
+}
+
+static int fd_write(int fd, const uint8_t *data, size_t size) {
+    while (size > 0) {
+        long n = write(fd, data, size);
+        if (n <= 0)
+            return -1;
+        data += n;
+        size -= n;
+    }
+    return 0;
+}
+
+static int memory_write(void *ctx, const uint8_t *data, size_t size) {
+    ge_Memory *mem = ctx;
+    uint8_t *grown;
+    size_t capacity;
+    if (mem->size + size > mem->capacity) {
+        capacity = mem->capacity ? mem->capacity : GE_OUT_SIZE;
+        while (capacity < mem->size + size)
+            capacity *= 2;
+        grown = realloc(mem->data, capacity);
+        if (!grown)
+            return -1;
+        mem->data = grown;
+        mem->capacity = capacity;
+    }
+    memcpy(mem->data + mem->size, data, size);
+    mem->size += size;
+    return 0;
+}
+
+ge_Sink ge_fd_sink(int fd) { return (ge_Sink){NULL, NULL, fd}; }
+
+ge_Sink ge_memory_sink(ge_Memory *mem) {
+    return (ge_Sink){memory_write, mem, -1};
+}
+
+ge_Sink ge_callback_sink(ge_WriteFn write, void *ctx) {
+    return (ge_Sink){write, ctx, -1};
+}
 
-static Node *new_node(uint16_t key, int degree) {
-    Node *node = calloc(1, sizeof(*node) + degree * sizeof(Node *));
-    if (node)
-        node->key = key;
-    return node;
+static int sink_write(const ge_Sink *sink, const void *data, size_t size) {
+    if (sink->write)
+        return sink->write(sink->ctx, data, size);
+    return fd_write(sink->fd, data, size);
 }
 
-static Node *new_trie(int degree, int *nkeys) {
-    Node *root = new_node(0, degree);
-    /* Create nodes for single pixels. */
-    for (*nkeys = 0; *nkeys < degree; (*nkeys)++)
-        root->children[*nkeys] = new_node(*nkeys, degree);
-    *nkeys += 2; /* skip clear code and stop code */
-    return root;
+/* Hand the buffered bytes to the sink. A failure is remembered for
+ * ge_close_gif and drops everything written after it. */
+static void flush_out(ge_GIF *gif) {
+    if (gif->out_size && !gif->error &&
+        sink_write(&gif->sink, gif->out, gif->out_size))
+        gif->error = 1;
+    gif->out_size = 0;
 }
 
-static void del_trie(Node *root, int degree) {
-    if (!root)
+static void put_bytes(ge_GIF *gif, const void *data, size_t n) {
+    gif->written += n;
+    if (gif->out_size + n > GE_OUT_SIZE)
+        flush_out(gif);
+    if (n > GE_OUT_SIZE) {
+        /* too big to buffer, straight to the sink */
+        if (!gif->error && sink_write(&gif->sink, data, n))
+            gif->error = 1;
         return;
-    for (int i = 0; i < degree; i++)
-        del_trie(root->children[i], degree);
-    free(root);
+    }
+    memcpy(gif->out + gif->out_size, data, n);
+    gif->out_size += n;
 }
 
-#define write_and_store(s, dst, fd, src, n)                                    \
+#define write_and_store(s, dst, gif, src, n)                                   \
     do {                                                                       \
-        write(fd, src, n);                                                     \
+        put_bytes(gif, src, n);                                                \
         if (s) {                                                               \
             memcpy(dst, src, n);                                               \
             dst += n;                                                          \
@@ -62,33 +133,74 @@ static void del_trie(Node *root, int degree) {
     } while (0);
 
 static void put_loop(ge_GIF *gif, uint16_t loop);
+static ge_GIF *new_gif(ge_Sink sink, uint16_t width, uint16_t height,
+                       uint8_t *palette, int depth, int bgindex, int loop,
+                       int nbuffers);
+
+/* Open fname for a gif with nbuffers canvases to draw frames in. */
+static ge_GIF *open_gif(const char *fname, uint16_t width, uint16_t height,
+                        uint8_t *palette, int depth, int bgindex, int loop,
+                        int nbuffers) {
+    ge_GIF *gif;
+    int fd;
+#ifdef _WIN32
+    fd = creat(fname, S_IWRITE);
+#else
+    fd = creat(fname, 0666);
+#endif
+    if (fd == -1)
+        return NULL;
+#ifdef _WIN32
+    setmode(fd, O_BINARY);
+#endif
+    gif = new_gif(ge_fd_sink(fd), width, height, palette, depth, bgindex,
+                  loop, nbuffers);
+    if (!gif)
+        close(fd);
+    else
+        gif->fd = fd;
+    return gif;
+}
 
 ge_GIF *ge_new_gif(const char *fname, uint16_t width, uint16_t height,
                    uint8_t *palette, int depth, int bgindex, int loop) {
+    return open_gif(fname, width, height, palette, depth, bgindex, loop,
+                    bgindex < 0 ? 2 : 1);
+}
+
+ge_GIF *ge_new_gif_images(const char *fname, uint16_t width, uint16_t height,
+                          uint8_t *palette, int depth, int bgindex,
+                          int loop) {
+    return open_gif(fname, width, height, palette, depth, bgindex, loop, 0);
+}
+
+ge_GIF *ge_new_gif_sink(ge_Sink sink, uint16_t width, uint16_t height,
+                        uint8_t *palette, int depth, int bgindex, int loop) {
+    return new_gif(sink, width, height, palette, depth, bgindex, loop,
+                   bgindex < 0 ? 2 : 1);
+}
+
+static ge_GIF *new_gif(ge_Sink sink, uint16_t width, uint16_t height,
+                       uint8_t *palette, int depth, int bgindex, int loop,
+                       int nbuffers) {
     int i, r, g, b, v;
     int store_gct, custom_gct;
-    int nbuffers = bgindex < 0 ? 2 : 1;
-    ge_GIF *gif = calloc(1, sizeof(*gif) + nbuffers * width * height);
+    ge_GIF *gif = calloc(1, sizeof(*gif) + (size_t)nbuffers * width * height);
     if (!gif)
         goto no_gif;
     gif->w = width;
     gif->h = height;
     gif->bgindex = bgindex;
-    gif->frame = (uint8_t *)&gif[1];
-    gif->back = &gif->frame[width * height];
-#ifdef _WIN32
-    gif->fd = creat(fname, S_IWRITE);
-#else
-    gif->fd = creat(fname, 0666);
-#endif
-    if (gif->fd == -1)
-        goto no_fd;
-#ifdef _WIN32
-    setmode(gif->fd, O_BINARY);
-#endif
-    write(gif->fd, "GIF89a", 6);
-    write_num(gif->fd, width);
-    write_num(gif->fd, height);
+    gif->transparent = -1;
+    if (nbuffers) {
+        gif->frame = (uint8_t *)&gif[1];
+        gif->back = &gif->frame[(size_t)width * height];
+    }
+    gif->fd = -1;
+    gif->sink = sink;
+    put_bytes(gif, "GIF89a", 6);
+    put_num(gif, width);
+    put_num(gif, height);
     store_gct = custom_gct = 0;
     if (palette) {
         if (depth < 0)
@@ -99,18 +211,21 @@ ge_GIF *ge_new_gif(const char *fname, uint16_t width, uint16_t height,
     if (depth < 0)
         depth = -depth;
     gif->depth = depth > 1 ? depth : 2;
-    write(gif->fd, (uint8_t[]){0xF0 | (depth - 1), (uint8_t)bgindex, 0x00}, 3);
+    /* Without frames, images come compressed by the caller's own dicts. */
+    if (nbuffers && ge_dict_init(&gif->dict, gif->depth))
+        goto no_dict;
+    put_bytes(gif, (uint8_t[]){0xF0 | (depth - 1), (uint8_t)bgindex, 0x00}, 3);
     if (custom_gct) {
-        write(gif->fd, palette, 3 << depth);
+        put_bytes(gif, palette, 3 << depth);
     } else if (depth <= 4) {
-        write_and_store(store_gct, palette, gif->fd, vga, 3 << depth);
+        write_and_store(store_gct, palette, gif, vga, 3 << depth);
     } else {
-        write_and_store(store_gct, palette, gif->fd, vga, sizeof(vga));
+        write_and_store(store_gct, palette, gif, vga, sizeof(vga));
         i = 0x10;
         for (r = 0; r < 6; r++) {
             for (g = 0; g < 6; g++) {
                 for (b = 0; b < 6; b++) {
-                    write_and_store(store_gct, palette, gif->fd,
+                    write_and_store(store_gct, palette, gif,
                                     ((uint8_t[]){r * 51, g * 51, b * 51}), 3);
                     if (++i == 1 << depth)
                         goto done_gct;
@@ -119,7 +234,7 @@ ge_GIF *ge_new_gif(const char *fname, uint16_t width, uint16_t height,
         }
         for (i = 1; i <= 24; i++) {
             v = i * 0xFF / 25;
-            write_and_store(store_gct, palette, gif->fd, ((uint8_t[]){v, v, v}),
+            write_and_store(store_gct, palette, gif, ((uint8_t[]){v, v, v}),
                             3);
         }
     }
@@ -127,102 +242,442 @@ done_gct:
     if (loop >= 0 && loop <= 0xFFFF)
         put_loop(gif, (uint16_t)loop);
     return gif;
-no_fd:
+no_dict:
     free(gif);
 no_gif:
     return NULL;
 }
 
 static void put_loop(ge_GIF *gif, uint16_t loop) {
-    write(gif->fd, (uint8_t[]){'!', 0xFF, 0x0B}, 3);
-    write(gif->fd, "NETSCAPE2.0", 11);
-    write(gif->fd, (uint8_t[]){0x03, 0x01}, 2);
-    write_num(gif->fd, loop);
-    write(gif->fd, "\0", 1);
+    put_bytes(gif, (uint8_t[]){'!', 0xFF, 0x0B}, 3);
+    put_bytes(gif, "NETSCAPE2.0", 11);
+    put_bytes(gif, (uint8_t[]){0x03, 0x01}, 2);
+    put_num(gif, loop);
+    put_bytes(gif, "\0", 1);
+}
+
+/* LZW output of one image, packed into sub-blocks. */
+typedef struct Coder {
+    ge_Memory *out;
+    int error;
+    int offset;
+    uint32_t partial;
+    uint8_t buffer[0xFF];
+    long bits;   /* written so far */
+    int clears;  /* after the first */
+    /* Window of pixels a full table is measured over in deferred mode,
+     * and the fewest bits per pixel one took, as bits over pixels. */
+    long window_end, window_bits, window_pixels;
+    long best_bits, best_pixels;
+} Coder;
+
+static void put_block(Coder *coder, const uint8_t *data, size_t n) {
+    if (memory_write(coder->out, data, n))
+        coder->error = 1;
 }
 
 /* Add packed key to buffer, updating offset and partial.
- *   gif->offset holds position to put next *bit*
- *   gif->partial holds bits to include in next byte */
-static void put_key(ge_GIF *gif, uint16_t key, int key_size) {
+ *   coder->offset holds position to put next *bit*
+ *   coder->partial holds bits to include in next byte */
+static void put_key(Coder *coder, uint16_t key, int key_size) {
     int byte_offset, bit_offset, bits_to_write;
-    byte_offset = gif->offset / 8;
-    bit_offset = gif->offset % 8;
-    gif->partial |= ((uint32_t)key) << bit_offset;
+    coder->bits += key_size;
+    byte_offset = coder->offset / 8;
+    bit_offset = coder->offset % 8;
+    coder->partial |= ((uint32_t)key) << bit_offset;
     bits_to_write = bit_offset + key_size;
     while (bits_to_write >= 8) {
-        gif->buffer[byte_offset++] = gif->partial & 0xFF;
+        coder->buffer[byte_offset++] = coder->partial & 0xFF;
         if (byte_offset == 0xFF) {
-            write(gif->fd, "\xFF", 1);
-            write(gif->fd, gif->buffer, 0xFF);
+            put_block(coder, (uint8_t *)"\xFF", 1);
+            put_block(coder, coder->buffer, 0xFF);
             byte_offset = 0;
         }
-        gif->partial >>= 8;
+        coder->partial >>= 8;
         bits_to_write -= 8;
     }
-    gif->offset = (gif->offset + key_size) % (0xFF * 8);
+    coder->offset = (coder->offset + key_size) % (0xFF * 8);
 }
 
-static void end_key(ge_GIF *gif) {
+static void end_key(Coder *coder) {
     int byte_offset;
-    byte_offset = gif->offset / 8;
-    if (gif->offset % 8)
-        gif->buffer[byte_offset++] = gif->partial & 0xFF;
+    byte_offset = coder->offset / 8;
+    if (coder->offset % 8)
+        coder->buffer[byte_offset++] = coder->partial & 0xFF;
     if (byte_offset) {
-        write(gif->fd, (uint8_t[]){byte_offset}, 1);
-        write(gif->fd, gif->buffer, byte_offset);
+        put_block(coder, (uint8_t[]){byte_offset}, 1);
+        put_block(coder, coder->buffer, byte_offset);
     }
-    write(gif->fd, "\0", 1);
-    gif->offset = gif->partial = 0;
+    put_block(coder, (uint8_t *)"\0", 1);
+    coder->offset = coder->partial = 0;
 }
 
-static void put_image(ge_GIF *gif, uint16_t w, uint16_t h, uint16_t x,
-                      uint16_t y) {
-    int nkeys, key_size, i, j;
-    Node *node, *child, *root;
-    int degree = 1 << gif->depth;
-
-    write(gif->fd, ",", 1);
-    write_num(gif->fd, x);
-    write_num(gif->fd, y);
-    write_num(gif->fd, w);
-    write_num(gif->fd, h);
-    write(gif->fd, (uint8_t[]){0x00, gif->depth}, 2);
-    root = node = new_trie(degree, &nkeys);
-    key_size = gif->depth + 1;
-    put_key(gif, degree, key_size); /* clear code */
-    for (i = y; i < y + h; i++) {
-        for (j = x; j < x + w; j++) {
-            uint8_t pixel = gif->frame[i * gif->w + j] & (degree - 1);
-            child = node->children[pixel];
-            if (child) {
-                node = child;
+#define GE_WINDOW 0x4000 /* pixels between checks of a full table */
+
+/* Whether a full code table should start over, pixels into the image. In
+ * deferred mode it's kept while windows of pixels take no more than 1/16
+ * more bits per pixel than the best window since it filled up. */
+static int clear_due(Coder *coder, const ge_Dict *dict, long pixels) {
+    long bits, n;
+
+    if (dict->clear == GE_CLEAR_FULL)
+        return 1;
+    if (!coder->window_end) {
+        coder->window_end = pixels + GE_WINDOW;
+        coder->window_bits = coder->bits;
+        coder->window_pixels = pixels;
+        coder->best_pixels = 0;
+        return 0;
+    }
+    if (pixels < coder->window_end)
+        return 0;
+    bits = coder->bits - coder->window_bits;
+    n = pixels - coder->window_pixels;
+    if (coder->best_pixels &&
+        bits * coder->best_pixels * 16 > coder->best_bits * n * 17) {
+        coder->window_end = 0;
+        return 1;
+    }
+    if (!coder->best_pixels ||
+        bits * coder->best_pixels < coder->best_bits * n) {
+        coder->best_bits = bits;
+        coder->best_pixels = n;
+    }
+    coder->window_end = pixels + GE_WINDOW;
+    coder->window_bits = coder->bits;
+    coder->window_pixels = pixels;
+    return 0;
+}
+
+/* Add the totals of an image to the dictionary's statistics. */
+static int count_image(ge_Dict *dict, Coder *coder, long pixels) {
+    dict->stats.pixels += pixels;
+    dict->stats.bytes += coder->out->size;
+    dict->stats.clears += coder->clears;
+    return coder->error ? -1 : 0;
+}
+
+/* Compress w x h pixels, rows stride bytes apart, into the image data
+ * sub-blocks that follow the LZW minimum code size. Returns -1 when out of
+ * memory. */
+int ge_compress(ge_Dict *dict, const uint8_t *pixels, size_t stride,
+                uint16_t w, uint16_t h, ge_Memory *data) {
+    int nkeys, key_size, i, j, next;
+    int code = -1;
+    int degree = dict->degree;
+    Coder coder = {0};
+
+    coder.out = data;
+    data->size = 0;
+    dict_reset(dict);
+    nkeys = degree + 2; /* skip clear code and stop code */
+    key_size = dict->depth + 1;
+    put_key(&coder, degree, key_size); /* clear code */
+    for (i = 0; i < h; i++) {
+        for (j = 0; j < w; j++) {
+            uint8_t pixel = pixels[i * stride + j] & (degree - 1);
+            if (code < 0) {
+                code = pixel;
+                continue;
+            }
+            next = dict->next[code * degree + pixel];
+            if (next) {
+                code = next;
             } else {
-                put_key(gif, node->key, key_size);
+                put_key(&coder, code, key_size);
                 if (nkeys < 0x1000) {
                     if (nkeys == (1 << key_size))
                         key_size++;
-                    node->children[pixel] = new_node(nkeys++, degree);
-                } else {
-                    put_key(gif, degree, key_size); /* clear code */
-                    del_trie(root, degree);
-                    root = node = new_trie(degree, &nkeys);
-                    key_size = gif->depth + 1;
+                    dict_add(dict, code, pixel, nkeys++);
+                } else if (clear_due(&coder, dict, (long)i * w + j)) {
+                    put_key(&coder, degree, key_size); /* clear code */
+                    coder.clears++;
+                    dict_reset(dict);
+                    nkeys = degree + 2;
+                    key_size = dict->depth + 1;
                 }
-                node = root->children[pixel];
+                code = pixel;
             }
         }
     }
-    put_key(gif, node->key, key_size);
-    put_key(gif, degree + 1, key_size); /* stop code */
-    end_key(gif);
-    del_trie(root, degree);
+    put_key(&coder, code, key_size);
+    put_key(&coder, degree + 1, key_size); /* stop code */
+    end_key(&coder);
+    return count_image(dict, &coder, (long)w * h);
+}
+
+/* Code table for images of blocks that repeat a pixel many times, which
+ * finds the same codes as ge_compress a run at a time instead of a pixel
+ * at a time. Every string is some base string followed by a run of one
+ * pixel value, and the strings with the same base and pixel get their codes
+ * in the order of their length, so the longest one that matches a run is
+ * found in one step. */
+#define RUN_SLOTS 0x2000
+#define RUN_KEY(base, pixel, n) ((uint32_t)(base) << 20 | (pixel) << 12 | (n))
+
+typedef struct ge_Runs {
+    uint32_t gen; /* slots of other generations are empty */
+    struct {
+        uint32_t gen, key;
+        uint16_t code;
+    } slots[RUN_SLOTS];
+    /* The string of each code: base followed by n copies of pixel. The
+     * base of single pixels is the clear code. longest is the most copies
+     * with a code, kept on the code of the first. */
+    uint16_t base[0x1000], n[0x1000], longest[0x1000];
+    uint8_t pixel[0x1000];
+} ge_Runs;
+
+static int runs_find(ge_Runs *runs, uint32_t key) {
+    uint32_t i = (key * 2654435761u) >> 19;
+    while (runs->slots[i].gen == runs->gen) {
+        if (runs->slots[i].key == key)
+            return runs->slots[i].code;
+        i = (i + 1) % RUN_SLOTS;
+    }
+    return -1;
+}
+
+static void runs_add(ge_Runs *runs, int base, uint8_t pixel, int n,
+                     int code) {
+    uint32_t key = RUN_KEY(base, pixel, n);
+    uint32_t i = (key * 2654435761u) >> 19;
+    while (runs->slots[i].gen == runs->gen)
+        i = (i + 1) % RUN_SLOTS;
+    runs->slots[i].gen = runs->gen;
+    runs->slots[i].key = key;
+    runs->slots[i].code = code;
+    runs->base[code] = base;
+    runs->pixel[code] = pixel;
+    runs->n[code] = n;
+    runs->longest[n == 1 ? code : runs_find(runs, RUN_KEY(base, pixel, 1))] =
+        n;
+}
+
+static void runs_reset(ge_Runs *runs, int degree) {
+    int i;
+    if (++runs->gen == 0) {
+        memset(runs->slots, 0, sizeof(runs->slots));
+        runs->gen = 1;
+    }
+    for (i = 0; i < degree; i++)
+        runs_add(runs, degree, i, 1, i);
+}
+
+/* The state of ge_compress_scaled, matching the runs of an image. */
+typedef struct RunCoder {
+    ge_Runs *runs;
+    Coder coder;
+    int depth, degree;
+    int nkeys, key_size;
+    int code; /* string matched so far, -1 before the first pixel */
+    long pixels; /* matched before this run */
+} RunCoder;
+
+static void put_run(RunCoder *rc, const ge_Dict *dict, uint8_t pixel,
+                    long length) {
+    ge_Runs *runs = rc->runs;
+    int base, first, to, next;
+    long end = rc->pixels + length;
+
+    while (length > 0) {
+        if (rc->code < 0) {
+            rc->code = pixel;
+            length--;
+            continue;
+        }
+        next = -1;
+        if (runs->pixel[rc->code] == pixel) {
+            /* Go further down the run the string ends with. */
+            base = runs->base[rc->code];
+            first = runs_find(runs, RUN_KEY(base, pixel, 1));
+            to = runs->n[rc->code] + length;
+            if (to > runs->longest[first])
+                to = runs->longest[first];
+            if (to > runs->n[rc->code]) {
+                length -= to - runs->n[rc->code];
+                rc->code = runs_find(runs, RUN_KEY(base, pixel, to));
+                continue;
+            }
+        } else {
+            next = runs_find(runs, RUN_KEY(rc->code, pixel, 1));
+        }
+        if (next >= 0) {
+            rc->code = next;
+            length--;
+            continue;
+        }
+
+        put_key(&rc->coder, rc->code, rc->key_size);
+        if (rc->nkeys < 0x1000) {
+            if (rc->nkeys == (1 << rc->key_size))
+                rc->key_size++;
+            if (runs->pixel[rc->code] == pixel)
+                runs_add(runs, runs->base[rc->code], pixel,
+                         runs->n[rc->code] + 1, rc->nkeys++);
+            else
+                runs_add(runs, rc->code, pixel, 1, rc->nkeys++);
+        } else if (clear_due(&rc->coder, dict, end - length)) {
+            put_key(&rc->coder, rc->degree, rc->key_size); /* clear code */
+            rc->coder.clears++;
+            runs_reset(runs, rc->degree);
+            rc->nkeys = rc->degree + 2;
+            rc->key_size = rc->depth + 1;
+        }
+        rc->code = pixel;
+        length--;
+    }
+    rc->pixels = end;
+}
+
+#define GE_MIN_SCALE 4 /* smaller blocks are drawn and compressed */
+
+/* Draw the blocks and compress them pixel by pixel, for scales whose runs
+ * are too short to be worth matching whole. */
+static int compress_blocks(ge_Dict *dict, const uint8_t *cells,
+                           size_t stride, int scale, ge_Rect r,
+                           ge_Memory *data) {
+    uint8_t *pixels, *line;
+    int y, x, end;
+
+    if (scale == 1)
+        return ge_compress(dict, &cells[r.y * stride + r.x], stride, r.w,
+                           r.h, data);
+    if ((size_t)r.w * r.h > dict->blocks.capacity) {
+        pixels = realloc(dict->blocks.data, (size_t)r.w * r.h);
+        if (!pixels)
+            return -1;
+        dict->blocks.data = pixels;
+        dict->blocks.capacity = (size_t)r.w * r.h;
+    }
+    pixels = dict->blocks.data;
+    for (y = r.y; y < r.y + r.h; y++) {
+        line = &pixels[(size_t)(y - r.y) * r.w];
+        if (y > r.y && y % scale) {
+            memcpy(line, line - r.w, r.w); /* same cells as above */
+            continue;
+        }
+        for (x = r.x; x < r.x + r.w; x = end) {
+            end = (x / scale + 1) * scale;
+            if (end > r.x + r.w)
+                end = r.x + r.w;
+            memset(&line[x - r.x], cells[(y / scale) * stride + x / scale],
+                   end - x);
+        }
+    }
+    return ge_compress(dict, pixels, r.w, r.w, r.h, data);
+}
+
+/* Compress the r area of an image made of cells scaled up to scale x scale
+ * pixel blocks, rows of cells stride bytes apart, without drawing it. The
+ * output is the same as ge_compress' for the drawn image, but a line costs
+ * as much as its runs of cells. Repeated lines are still coded one by one,
+ * as the codes they get depend on the table left by the lines before, so
+ * an image costs its runs of cells times scale. Returns -1 when out of
+ * memory. */
+int ge_compress_scaled(ge_Dict *dict, const uint8_t *cells, size_t stride,
+                       int scale, ge_Rect r, ge_Memory *data) {
+    RunCoder rc = {0};
+    const uint8_t *line;
+    int y, x, end;
+    uint8_t pixel = 0, cell;
+    long length = 0;
+
+    if (scale < GE_MIN_SCALE)
+        return compress_blocks(dict, cells, stride, scale, r, data);
+    if (!dict->runs) {
+        dict->runs = calloc(1, sizeof(ge_Runs));
+        if (!dict->runs)
+            return -1;
+    }
+
+    rc.runs = dict->runs;
+    rc.coder.out = data;
+    rc.depth = dict->depth;
+    rc.degree = dict->degree;
+    rc.nkeys = dict->degree + 2; /* skip clear code and stop code */
+    rc.key_size = dict->depth + 1;
+    rc.code = -1;
+    data->size = 0;
+    runs_reset(rc.runs, rc.degree);
+    put_key(&rc.coder, rc.degree, rc.key_size); /* clear code */
+    for (y = r.y; y < r.y + r.h; y++) {
+        line = cells + (size_t)(y / scale) * stride;
+        for (x = r.x; x < r.x + r.w; x = end) {
+            end = (x / scale + 1) * scale;
+            if (end > r.x + r.w)
+                end = r.x + r.w;
+            cell = line[x / scale] & (rc.degree - 1);
+            if (cell != pixel) {
+                put_run(&rc, dict, pixel, length);
+                pixel = cell;
+                length = 0;
+            }
+            length += end - x;
+        }
+    }
+    put_run(&rc, dict, pixel, length);
+    put_key(&rc.coder, rc.code, rc.key_size);
+    put_key(&rc.coder, rc.degree + 1, rc.key_size); /* stop code */
+    end_key(&rc.coder);
+    return count_image(dict, &rc.coder, (long)r.w * r.h);
+}
+
+static void put_descriptor(ge_GIF *gif, ge_Rect r) {
+    put_bytes(gif, ",", 1);
+    put_num(gif, r.x);
+    put_num(gif, r.y);
+    put_num(gif, r.w);
+    put_num(gif, r.h);
+    put_bytes(gif, (uint8_t[]){0x00, gif->depth}, 2);
+}
+
+/* Copy the pixels of r that changed since the last frame, and the
+ * transparent index for the others, into the dictionary's blocks. */
+static uint8_t *diff_pixels(ge_GIF *gif, ge_Rect r) {
+    ge_Memory *mem = &gif->dict.blocks;
+    uint8_t *pixels, *frame, *back;
+    int i, j;
+
+    if ((size_t)r.w * r.h > mem->capacity) {
+        pixels = realloc(mem->data, (size_t)r.w * r.h);
+        if (!pixels)
+            return NULL;
+        mem->data = pixels;
+        mem->capacity = (size_t)r.w * r.h;
+    }
+    pixels = mem->data;
+    for (i = 0; i < r.h; i++) {
+        frame = &gif->frame[(size_t)(r.y + i) * gif->w + r.x];
+        back = &gif->back[(size_t)(r.y + i) * gif->w + r.x];
+        for (j = 0; j < r.w; j++)
+            *pixels++ = frame[j] == back[j] ? gif->transparent : frame[j];
+    }
+    return mem->data;
+}
+
+static void put_image(ge_GIF *gif, uint16_t w, uint16_t h, uint16_t x,
+                      uint16_t y) {
+    ge_Rect r = {x, y, w, h};
+    const uint8_t *pixels = &gif->frame[(size_t)y * gif->w + x];
+    size_t stride = gif->w;
+
+    if (gif->transparent >= 0 && gif->nframes > 0) {
+        pixels = diff_pixels(gif, r);
+        stride = w;
+    }
+    put_descriptor(gif, r);
+    if (!pixels || ge_compress(&gif->dict, pixels, stride, w, h, &gif->image))
+        gif->error = 1;
+    else
+        put_bytes(gif, gif->image.data, gif->image.size);
 }
 
 static int get_bbox(ge_GIF *gif, uint16_t *w, uint16_t *h, uint16_t *x,
                     uint16_t *y) {
-    int i, j, k;
+    int i, j;
     int left, right, top, bottom;
+    size_t k;
     uint8_t back;
     left = gif->w;
     right = 0;
@@ -257,16 +712,22 @@ static int get_bbox(ge_GIF *gif, uint16_t *w, uint16_t *h, uint16_t *x,
 
 static void add_graphics_control_extension(ge_GIF *gif, uint16_t d) {
     uint8_t flags = ((gif->bgindex >= 0 ? 2 : 1) << 2) + 1;
-    write(gif->fd, (uint8_t[]){'!', 0xF9, 0x04, flags}, 4);
-    write_num(gif->fd, d);
-    write(gif->fd, (uint8_t[]){(uint8_t)gif->bgindex, 0x00}, 2);
+    int index = gif->bgindex >= 0 ? gif->bgindex : gif->transparent;
+    put_bytes(gif, (uint8_t[]){'!', 0xF9, 0x04, flags}, 4);
+    put_num(gif, d);
+    put_bytes(gif, (uint8_t[]){(uint8_t)index, 0x00}, 2);
 }
 
+/* Frames need a graphic control extension for their delay or for pixels
+ * that are transparent. */
+#define needs_control(gif, delay)                                             \
+    ((delay) || (gif)->bgindex >= 0 || (gif)->transparent >= 0)
+
 void ge_add_frame(ge_GIF *gif, uint16_t delay) {
     uint16_t w, h, x, y;
     uint8_t *tmp;
 
-    if (delay || (gif->bgindex >= 0))
+    if (needs_control(gif, delay))
         add_graphics_control_extension(gif, delay);
     if (gif->nframes == 0) {
         w = gif->w;
@@ -286,8 +747,141 @@ void ge_add_frame(ge_GIF *gif, uint16_t delay) {
     }
 }
 
-void ge_close_gif(ge_GIF *gif) {
-    write(gif->fd, ";", 1);
-    close(gif->fd);
+/* Pixels a separate image has to save to be worth its header and LZW
+ * restart. */
+#define GE_RECT_COST 4096
+
+static ge_Rect rect_union(ge_Rect a, ge_Rect b) {
+    int x = a.x < b.x ? a.x : b.x;
+    int y = a.y < b.y ? a.y : b.y;
+    int r = a.x + a.w > b.x + b.w ? a.x + a.w : b.x + b.w;
+    int d = a.y + a.h > b.y + b.h ? a.y + a.h : b.y + b.h;
+    return (ge_Rect){x, y, r - x, d - y};
+}
+
+#define rect_area(r) ((long)(r).w * (r).h)
+
+/* Merge rects that are cheaper to encode as one image, at most
+ * GE_MAX_RECTS of them. Returns how many are left in out. */
+static int merge_rects(const ge_Rect *rects, int count, ge_Rect *out) {
+    int i, j, n = 0;
+    ge_Rect u;
+    for (i = 0; i < count; i++) {
+        if (rects[i].w == 0 || rects[i].h == 0)
+            continue;
+        if (n == GE_MAX_RECTS) {
+            out[n - 1] = rect_union(out[n - 1], rects[i]);
+            continue;
+        }
+        out[n++] = rects[i];
+    }
+    for (i = 0; i < n; i++) {
+        for (j = i + 1; j < n; j++) {
+            u = rect_union(out[i], out[j]);
+            if (rect_area(u) <=
+                rect_area(out[i]) + rect_area(out[j]) + GE_RECT_COST) {
+                out[i] = u;
+                out[j] = out[--n];
+                j = i; /* out[i] grew, check the others again */
+            }
+        }
+    }
+    return n;
+}
+
+/* Pick the images of a frame from the areas that changed, merging those
+ * cheaper to encode together. A frame without changes gets a single pixel
+ * to carry its delay. Returns how many images were written to images, at
+ * most GE_MAX_RECTS. */
+int ge_plan_rects(const ge_Rect *rects, int count, ge_Rect *images) {
+    int n = merge_rects(rects, count, images);
+    if (n == 0) {
+        images[0] = (ge_Rect){0, 0, 1, 1};
+        n = 1;
+    }
+    return n;
+}
+
+/* Pick the images of the next frame as ge_plan_rects does, or from a scan
+ * against the last frame if rects is NULL. The first frame should be the
+ * whole canvas. */
+static int plan_images(ge_GIF *gif, const ge_Rect *rects, int count,
+                       ge_Rect *images) {
+    uint16_t w = 0, h = 0, x = 0, y = 0;
+
+    if (!rects) {
+        count = get_bbox(gif, &w, &h, &x, &y);
+        images[0] = (ge_Rect){x, y, w, h};
+        rects = images;
+    }
+    return ge_plan_rects(rects, count, images);
+}
+
+/* Bring the last frame up to date under the images written. */
+static void keep_images(ge_GIF *gif, const ge_Rect *images, int n) {
+    int i, row;
+
+    if (gif->bgindex >= 0)
+        return;
+    for (i = 0; i < n; i++)
+        for (row = images[i].y; row < images[i].y + images[i].h; row++)
+            memcpy(&gif->back[(size_t)row * gif->w + images[i].x],
+                   &gif->frame[(size_t)row * gif->w + images[i].x],
+                   images[i].w);
+}
+
+int ge_plan_frame(ge_GIF *gif, const ge_Rect *rects, int count,
+                  ge_Rect *images) {
+    int n = plan_images(gif, rects, count, images);
+    keep_images(gif, images, n);
+    return n;
+}
+
+/* Add a frame that only differs from the last one inside rects, without
+ * scanning for the changes. Unlike ge_add_frame, frame keeps its pixels,
+ * so only the rects of the next frame need drawing. Separate areas of
+ * change go in separate images, the last one carrying the delay. */
+void ge_add_frame_rects(ge_GIF *gif, uint16_t delay, const ge_Rect *rects,
+                        int count) {
+    ge_Rect canvas = {0, 0, gif->w, gif->h};
+    ge_Rect images[GE_MAX_RECTS];
+    int i, n;
+
+    if (gif->nframes == 0)
+        n = plan_images(gif, &canvas, 1, images);
+    else
+        n = plan_images(gif, rects, count, images);
+    for (i = 0; i < n; i++) {
+        if (needs_control(gif, delay))
+            add_graphics_control_extension(gif, i == n - 1 ? delay : 0);
+        put_image(gif, images[i].w, images[i].h, images[i].x, images[i].y);
+    }
+    keep_images(gif, images, n);
+    gif->nframes++;
+}
+
+/* Write a frame of images from ge_compress. */
+void ge_add_images(ge_GIF *gif, uint16_t delay, const ge_Image *images,
+                   int count) {
+    int i;
+    for (i = 0; i < count; i++) {
+        if (needs_control(gif, delay))
+            add_graphics_control_extension(gif, i == count - 1 ? delay : 0);
+        put_descriptor(gif, images[i].rect);
+        put_bytes(gif, images[i].data.data, images[i].data.size);
+    }
+    gif->nframes++;
+}
+
+int ge_close_gif(ge_GIF *gif) {
+    int error;
+    put_bytes(gif, ";", 1);
+    flush_out(gif);
+    error = gif->error;
+    if (gif->fd != -1 && close(gif->fd) != 0)
+        error = 1;
+    ge_dict_free(&gif->dict); /* zeroed if never allocated */
+    free(gif->image.data);
     free(gif);
+    return error ? -1 : 0;
 }
@@ -1,28 +1,130 @@
 #ifndef GIFENC_H
 #define GIFENC_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Where encoded bytes go: a file descriptor, or a callback that returns 0
+ * once it has taken all the bytes and -1 on failure. */
+typedef int (*ge_WriteFn)(void *ctx, const uint8_t *data, size_t size);
+
+typedef struct ge_Sink {
+    ge_WriteFn write; /* NULL to write to fd */
+    void *ctx;
+    int fd;
+} ge_Sink;
+
+/* Growing memory buffer filled by a memory sink; data is the caller's to
+ * free. */
+typedef struct ge_Memory {
+    uint8_t *data;
+    size_t size, capacity;
+} ge_Memory;
+
+#define GE_OUT_SIZE 0x10000
+
+/* When a full LZW code table starts over: at once, as the gif encoders
+ * always did, or only once the bits spent per pixel grow, which keeps long
+ * boring runs of frames on long strings. */
+enum { GE_CLEAR_FULL, GE_CLEAR_DEFERRED };
+
+/* Totals of the images a code table compressed. */
+typedef struct ge_Stats {
+    uint64_t pixels, bytes, clears;
+} ge_Stats;
+
+/* LZW code table, reused by every image: next[code * degree + pixel] is
+ * the code that extends `code` with `pixel`, 0 if there's none yet. Rows
+ * are cleared as their codes are handed out, so only the rows of single
+ * pixels need clearing to start over. ge_compress_scaled keeps its codes
+ * by runs instead, allocated the first time. Threads compressing at the
+ * same time need one each. */
+typedef struct ge_Dict {
+    int depth;
+    int degree;
+    uint16_t *next;
+    struct ge_Runs *runs;
+    ge_Memory blocks; /* small blocks drawn by ge_compress_scaled */
+    int clear;        /* GE_CLEAR_FULL unless set after ge_dict_init */
+    ge_Stats stats;
+} ge_Dict;
+
+/* Area of the canvas that changed since the last frame. */
+typedef struct ge_Rect {
+    uint16_t x, y, w, h;
+} ge_Rect;
+
+#define GE_MAX_RECTS 16 /* images per frame */
+
+/* Image of a frame compressed ahead of time by ge_compress. */
+typedef struct ge_Image {
+    ge_Rect rect;
+    ge_Memory data;
+} ge_Image;
+
 typedef struct ge_GIF {
     uint16_t w, h;
     int depth;
     int bgindex;
-    int fd;
-    int offset;
+    /* Index the palette leaves unused, or -1. If set while bgindex < 0,
+     * ge_add_frame and ge_add_frame_rects write it for the pixels of a
+     * frame that are the same as in the last one, which is not disposed
+     * of, so unchanged areas become runs of one code. Callers encoding
+     * with ge_compress write it into their own images. */
+    int transparent;
+    int fd; /* opened by ge_new_gif, -1 otherwise */
+    ge_Sink sink;
+    int error;
+    size_t out_size;
+    uint8_t out[GE_OUT_SIZE];
+    uint64_t written; /* bytes of the gif so far, buffered ones included */
     int nframes;
-    uint8_t *frame, *back;
-    uint32_t partial;
-    uint8_t buffer[0xFF];
+    uint8_t *frame, *back; /* NULL for ge_new_gif_images */
+    ge_Dict dict; /* unallocated for ge_new_gif_images */
+    ge_Memory image; /* data of the image being written */
 } ge_GIF;
 
+ge_Sink ge_fd_sink(int fd);
+ge_Sink ge_memory_sink(ge_Memory *mem);
+ge_Sink ge_callback_sink(ge_WriteFn write, void *ctx);
+
 ge_GIF *ge_new_gif(const char *fname, uint16_t width, uint16_t height,
                    uint8_t *palette, int depth, int bgindex, int loop);
+ge_GIF *ge_new_gif_sink(ge_Sink sink, uint16_t width, uint16_t height,
+                        uint8_t *palette, int depth, int bgindex, int loop);
+/* Like ge_new_gif, for gifs only written with ge_add_images: there is no
+ * frame to draw in nor code table of its own, so ge_add_frame,
+ * ge_add_frame_rects and ge_plan_frame can't be used on them. */
+ge_GIF *ge_new_gif_images(const char *fname, uint16_t width, uint16_t height,
+                          uint8_t *palette, int depth, int bgindex,
+                          int loop);
 void ge_add_frame(ge_GIF *gif, uint16_t delay);
-void ge_close_gif(ge_GIF *gif);
+void ge_add_frame_rects(ge_GIF *gif, uint16_t delay, const ge_Rect *rects,
+                        int count);
+int ge_close_gif(ge_GIF *gif); /* -1 if anything failed to be written */
+
+/* Frames can also be compressed apart from writing them, on any thread:
+ * ge_plan_frame picks the images of the next frame, ge_compress encodes
+ * each one, and ge_add_images writes them in order. The output is the
+ * same as ge_add_frame_rects'. Callers that keep their own smaller frame,
+ * scaled up by a whole factor, can plan with ge_plan_rects and encode
+ * straight from it with ge_compress_scaled, at a cost in runs of their
+ * pixels per line of the gif rather than in pixels. */
+int ge_dict_init(ge_Dict *dict, int depth);
+void ge_dict_free(ge_Dict *dict);
+int ge_plan_frame(ge_GIF *gif, const ge_Rect *rects, int count,
+                  ge_Rect *images);
+int ge_plan_rects(const ge_Rect *rects, int count, ge_Rect *images);
+int ge_compress(ge_Dict *dict, const uint8_t *pixels, size_t stride,
+                uint16_t w, uint16_t h, ge_Memory *data);
+int ge_compress_scaled(ge_Dict *dict, const uint8_t *cells, size_t stride,
+                       int scale, ge_Rect r, ge_Memory *data);
+void ge_add_images(ge_GIF *gif, uint16_t delay, const ge_Image *images,
+                   int count);
 
 #ifdef __cplusplus
 }